@@ -0,0 +1,571 @@
+#! /usr/bin/env python
+"""
+Run the launch matrix concurrently and collect the scorer results into one table.
+
+Each scenario gets its own ROS master, Gazebo master, log directory and CPU set,
+so several can run on one machine without seeing each other. A scenario is done
+shortly after the scorers print their final results, or when it times out.
+
+With --record each scenario is also recorded to walk.rec in its output directory
+for offline scoring with rescore, e.g.
+  rosrun dogsim rescore output:=/tmp/matrix/rescored.csv /tmp/matrix/*/walk.rec
+
+With --seeds each scenario is repeated with successive gauss_seed values until
+the 95% confidence intervals of the stop metrics are tight enough.
+
+Example:
+  rosrun dogsim run_scenarios.py --jobs 6 --output /tmp/matrix
+  rosrun dogsim run_scenarios.py --only 'lissajous_.*_heuristic' --jobs 2
+  rosrun dogsim run_scenarios.py --only 'bad_dog' --seeds 20 --ci-width 0.05
+"""
+import argparse
+import csv
+import multiprocessing
+import os
+import re
+import signal
+import socket
+import subprocess
+import sys
+import threading
+import time
+import traceback
+
+try:
+    import Queue as queue
+except ImportError:
+    import queue
+
+PATHS = ['lissajous', 'rectangle', 'blockwalk']
+DOGS = ['good_dog', 'bad_dog']
+MODES = ['heuristic', 'high_arm', 'no_steering', 'solo_dog']
+
+# The robot walks alone in solo_robot, so it has no dog variant.
+SOLO_ROBOT = 'solo_robot'
+
+# Final lines printed by the scorers, keyed by the column they fill.
+RESULT_PATTERNS = [
+    (re.compile(r'^Path measurement ended\. Total position deviation squared\(m\): (\S+)'),
+     ['path_deviation']),
+    (re.compile(r'^Mean height deviation: (\S+)'), ['height_deviation']),
+    (re.compile(r'^Robot Path measurement ended\. Total position deviation squared\(m\): (\S+)'),
+     ['robot_deviation']),
+    (re.compile(r'^Total leash force\(N\): (\S+)'), ['leash_force']),
+    (re.compile(r'^Mean Leash Stretch: (\S+), Leash Stretch Variance: (\S+), Maximum Leash Stretch: (\S+)'),
+     ['stretch_mean', 'stretch_variance', 'stretch_max']),
+    (re.compile(r'^Total force\(Nm\): (\S+)'), ['total_force']),
+    (re.compile(r'^Total path visibility score was (\S+) over (\S+) seconds'),
+     ['visibility_score', 'visibility_time']),
+    (re.compile(r'^Total Known Time: .* Percent Known: (\S+),'), ['percent_known']),
+    (re.compile(r'^Mean Position Deviation: (\S+), Position Variance: (\S+)'),
+     ['position_deviation_mean', 'position_deviation_variance']),
+    (re.compile(r'^Measured (\S+) s of sim time in (\S+) s of wall time\. Speedup: (\S+)'),
+     ['sim_time', 'measured_wall_time', 'speedup']),
+]
+
+RESULT_COLUMNS = [column for _, columns in RESULT_PATTERNS for column in columns]
+
+# Columns that describe how fast a run went rather than how well it scored.
+TIMING_COLUMNS = ['sim_time', 'measured_wall_time', 'speedup']
+SCORE_COLUMNS = [column for column in RESULT_COLUMNS if column not in TIMING_COLUMNS]
+
+# rosconsole prefixes each line with the level and stamps and may color it.
+CONSOLE_MESSAGE = re.compile(r'\[[^\]]*\]\s*(?:\[[^\]]*\])?:\s*(.*)$')
+ANSI_ESCAPE = re.compile(r'\x1b\[[0-9;]*m')
+
+DEFAULT_WORLD = 'pr2_gazebo pr2_empty_world.launch gui:=false'
+
+
+def find_scenarios(launch_dir, only):
+    """ Scenario names in matrix order that have a launch file and match the filter. """
+    names = []
+    for path in PATHS:
+        for dog in DOGS:
+            for mode in MODES:
+                names.append('%s_%s_%s' % (path, dog, mode))
+        names.append('%s_%s' % (path, SOLO_ROBOT))
+
+    pattern = re.compile(only) if only else None
+    scenarios = []
+    for name in names:
+        if not os.path.exists(os.path.join(launch_dir, name + '.launch')):
+            print('Skipping %s, it has no launch file' % name)
+            continue
+        if pattern and not pattern.search(name):
+            continue
+        scenarios.append(name)
+    return scenarios
+
+
+def split_cpus(jobs):
+    """ Split the CPUs into one contiguous set per concurrent scenario. """
+    count = multiprocessing.cpu_count()
+    per_job = max(count // jobs, 1)
+    sets = []
+    for slot in range(jobs):
+        first = (slot * per_job) % count
+        sets.append('%d-%d' % (first, min(first + per_job, count) - 1))
+    return sets
+
+
+def parse_result(line, results):
+    """ Fill in any result columns found in a line of console output. """
+    line = ANSI_ESCAPE.sub('', line).strip()
+    match = CONSOLE_MESSAGE.search(line)
+    message = match.group(1) if match else line
+    for pattern, columns in RESULT_PATTERNS:
+        found = pattern.match(message)
+        if found:
+            for column, value in zip(columns, found.groups()):
+                results[column] = value
+            return True
+    return False
+
+
+def wait_for_port(port, timeout):
+    deadline = time.time() + timeout
+    while time.time() < deadline:
+        try:
+            socket.create_connection(('localhost', port), 1).close()
+            return True
+        except socket.error:
+            time.sleep(0.5)
+    return False
+
+
+def stop(process, timeout=15.0):
+    """ Interrupt a process group like Ctrl-C, escalating if it does not exit. """
+    if process is None or process.poll() is not None:
+        return
+    for sig in [signal.SIGINT, signal.SIGTERM, signal.SIGKILL]:
+        try:
+            os.killpg(process.pid, sig)
+        except OSError:
+            return
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            if process.poll() is not None:
+                return
+            time.sleep(0.2)
+
+
+class Slot(object):
+    """ Ports and CPUs reserved for one concurrently running scenario. """
+
+    def __init__(self, index, base_port, cpus):
+        self.index = index
+        self.ros_port = base_port + 2 * index
+        self.gazebo_port = base_port + 2 * index + 1
+        self.cpus = cpus
+
+
+def run_scenario(scenario, slot, options, params=None, suffix=''):
+    """
+    Run one scenario to completion in the given slot.
+    @param params Extra parameters set on the master before launching.
+    @param suffix Appended to the scenario name for the output directory.
+    @return Dictionary of the result columns plus scenario, status and wall_time.
+    """
+    name = scenario + suffix
+    directory = os.path.join(options.output, name)
+    log_dir = os.path.join(directory, 'log')
+    if not os.path.isdir(log_dir):
+        os.makedirs(log_dir)
+
+    env = dict(os.environ)
+    env['ROS_MASTER_URI'] = 'http://localhost:%d' % slot.ros_port
+    env['GAZEBO_MASTER_URI'] = 'http://localhost:%d' % slot.gazebo_port
+    env['ROS_LOG_DIR'] = log_dir
+    env['ROS_HOME'] = directory
+
+    outputs = []
+
+    def start(command, output_name):
+        output = open(os.path.join(directory, output_name), 'w')
+        outputs.append(output)
+        if options.pin:
+            command = ['taskset', '-c', slot.cpus] + command
+        return subprocess.Popen(command, env=env, stdout=output, stderr=subprocess.STDOUT,
+                                preexec_fn=os.setsid)
+
+    results = {'scenario': name, 'status': 'timeout'}
+    started = time.time()
+    processes = []
+    try:
+        core = start(['roscore', '-p', str(slot.ros_port)], 'roscore.out')
+        processes.append(core)
+        if not wait_for_port(slot.ros_port, 30):
+            results['status'] = 'no_master'
+            return results
+
+        all_params = dict(params or {})
+        if options.max_update_rate is not None or options.record:
+            # Every node must follow /clock when the world runs faster than real time. The
+            # recorder starts before the scenario launch sets it, and stamps with sim time.
+            all_params['/use_sim_time'] = 'true'
+        if options.max_update_rate is not None:
+            all_params['/max_update_rate'] = options.max_update_rate
+        for key, value in sorted(all_params.items()):
+            subprocess.check_call(['rosparam', 'set', key, str(value)], env=env)
+
+        world = start(['roslaunch'] + options.world.split(), 'world.out')
+        processes.append(world)
+        if options.max_update_rate is not None:
+            processes.append(start(['rosrun', 'dogsim', 'set_max_update_rate'], 'set_max_update_rate.out'))
+        if options.record:
+            # Stopped before the world, so it closes the recording cleanly.
+            recording = os.path.abspath(os.path.join(directory, 'walk.rec'))
+            processes.append(start(['rosrun', 'dogsim', 'recorder', '_file:=' + recording], 'recorder.out'))
+
+        launch_file = os.path.join(options.launch_dir, scenario + '.launch')
+        command = ['roslaunch', launch_file]
+        if options.pin:
+            command = ['taskset', '-c', slot.cpus] + command
+        launch = subprocess.Popen(command, env=env, stdout=subprocess.PIPE,
+                                  stderr=subprocess.STDOUT, preexec_fn=os.setsid)
+        processes.append(launch)
+
+        # Read the scenario output on a thread so the timeout is honoured while it is quiet.
+        lines = queue.Queue()
+
+        def read_output():
+            with open(os.path.join(directory, 'scenario.out'), 'w') as output:
+                for line in iter(launch.stdout.readline, b''):
+                    line = line.decode('utf-8', 'replace')
+                    output.write(line)
+                    output.flush()
+                    lines.put(line)
+
+        reader = threading.Thread(target=read_output)
+        reader.daemon = True
+        reader.start()
+
+        deadline = started + options.timeout
+        finished = None
+        while time.time() < deadline:
+            if finished is not None and time.time() > finished + options.grace:
+                results['status'] = 'ok'
+                break
+            if launch.poll() is not None and lines.empty():
+                results['status'] = 'ok' if finished is not None else 'exited'
+                break
+            try:
+                line = lines.get(timeout=0.5)
+            except queue.Empty:
+                continue
+            if parse_result(line, results) and finished is None:
+                # The other scorers stop on the same message, give them time to print.
+                finished = time.time()
+    finally:
+        for process in reversed(processes):
+            stop(process)
+        for output in outputs:
+            output.close()
+        results['wall_time'] = '%.1f' % (time.time() - started)
+    return results
+
+
+def write_table(rows, file_name, columns=None):
+    columns = columns or ['scenario', 'status', 'wall_time'] + RESULT_COLUMNS
+    with open(file_name, 'w') as output:
+        writer = csv.DictWriter(output, columns, restval='')
+        writer.writeheader()
+        for row in rows:
+            writer.writerow(row)
+
+
+def print_table(rows, columns=None):
+    columns = columns or ['scenario', 'status', 'wall_time'] + RESULT_COLUMNS
+    columns = [column for column in columns if any(column in row for row in rows)]
+    widths = [max([len(column)] + [len(str(row.get(column, ''))) for row in rows]) for column in columns]
+    print('  '.join(column.ljust(width) for column, width in zip(columns, widths)))
+    for row in rows:
+        print('  '.join(str(row.get(column, '')).ljust(width) for column, width in zip(columns, widths)))
+
+
+def run_slots(options, next_task, finished):
+    """
+    Run tasks over the slots until next_task returns None.
+    @param next_task Returns (scenario, params, suffix, key) or None. May block until a task is available.
+    @param finished Called with the key and result row of each task.
+    """
+    def worker(slot):
+        while True:
+            task = next_task()
+            if task is None:
+                return
+            scenario, params, suffix, key = task
+            print('Starting %s%s on ports %d/%d cpus %s' % (scenario, suffix, slot.ros_port,
+                                                           slot.gazebo_port, slot.cpus))
+            started = time.time()
+            try:
+                row = run_scenario(scenario, slot, options, params, suffix)
+            except Exception:
+                # Keep the slot running and still give the task a row.
+                traceback.print_exc()
+                row = {'scenario': scenario + suffix, 'status': 'error',
+                       'wall_time': '%.1f' % (time.time() - started)}
+            print('Finished %s with status %s in %s s' % (row['scenario'], row['status'], row['wall_time']))
+            finished(key, row)
+
+    cpus = split_cpus(options.jobs)
+    threads = [threading.Thread(target=worker, args=(Slot(i, options.base_port, cpus[i]),))
+               for i in range(options.jobs)]
+    for thread in threads:
+        thread.daemon = True
+        thread.start()
+    for thread in threads:
+        while thread.is_alive():
+            thread.join(1.0)
+
+
+def run_all(tasks, options):
+    """
+    Run (scenario, params, suffix) tasks over the slots and return the results in task order.
+    """
+    pending = queue.Queue()
+    for i, (scenario, params, suffix) in enumerate(tasks):
+        pending.put((scenario, params, suffix, i))
+    rows = [None] * len(tasks)
+
+    def next_task():
+        try:
+            return pending.get_nowait()
+        except queue.Empty:
+            return None
+
+    def finished(i, row):
+        rows[i] = row
+
+    run_slots(options, next_task, finished)
+    return rows
+
+
+# Two sided 95% Student t quantiles by degrees of freedom. Larger samples use the normal quantile.
+T_95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+Z_95 = 1.960
+
+
+class RunningStats(object):
+    """ Streaming mean and variance using Welford's method. """
+
+    def __init__(self):
+        self.n = 0
+        self.mean = 0.0
+        self.m2 = 0.0
+
+    def add(self, value):
+        self.n += 1
+        delta = value - self.mean
+        self.mean += delta / self.n
+        self.m2 += delta * (value - self.mean)
+
+    def variance(self):
+        return self.m2 / (self.n - 1) if self.n > 1 else float('nan')
+
+    def half_width(self):
+        """ Half width of the 95% confidence interval of the mean. """
+        if self.n < 2:
+            return float('inf')
+        t = T_95[self.n - 2] if self.n - 1 <= len(T_95) else Z_95
+        return t * (self.variance() / self.n) ** 0.5
+
+
+class ScenarioEnsemble(object):
+    """ Seeds launched and results gathered for one scenario. """
+
+    def __init__(self, scenario):
+        self.scenario = scenario
+        self.launched = 0
+        self.running = 0
+        self.failed = 0
+        self.reported = False
+        self.stats = dict((column, RunningStats()) for column in RESULT_COLUMNS)
+
+    def add(self, row):
+        if row['status'] != 'ok':
+            self.failed += 1
+            return
+        for column, stats in self.stats.items():
+            try:
+                stats.add(float(row[column]))
+            except (KeyError, ValueError):
+                pass
+
+    def converged(self, options):
+        """ True once every stop metric that was reported has a tight enough interval. """
+        reported = [self.stats[column] for column in options.stop_metrics if self.stats[column].n > 0]
+        if not reported or min(stats.n for stats in reported) < options.min_seeds:
+            return False
+        return all(stats.half_width() <= options.ci_width * abs(stats.mean) for stats in reported)
+
+    def summary(self, options):
+        row = {'scenario': self.scenario, 'seeds': self.launched, 'failed': self.failed,
+               'converged': self.converged(options)}
+        for column, stats in self.stats.items():
+            if stats.n > 0:
+                row[column + '_mean'] = '%g' % stats.mean
+                row[column + '_std'] = '%g' % (stats.variance() ** 0.5 if stats.n > 1 else 0.0)
+                row[column + '_ci'] = '%g' % stats.half_width()
+        return row
+
+
+def run_ensembles(scenarios, options):
+    """
+    Run each scenario with successive seeds until the stop metrics converge or the
+    seed budget is spent. At most seed_batch seeds of a scenario run at once, so
+    the early stop is checked before the whole budget has been launched.
+    @return The per run rows and the per scenario summaries.
+    """
+    ensembles = [ScenarioEnsemble(scenario) for scenario in scenarios]
+    rows = []
+    condition = threading.Condition()
+
+    def next_task():
+        with condition:
+            while True:
+                waiting = False
+                for ensemble in ensembles:
+                    if ensemble.launched >= options.seeds or ensemble.converged(options):
+                        continue
+                    if ensemble.running < options.seed_batch:
+                        seed = options.first_seed + ensemble.launched
+                        ensemble.launched += 1
+                        ensemble.running += 1
+                        return (ensemble.scenario, {'/gauss_seed': seed}, '_seed%d' % seed, (ensemble, seed))
+                    waiting = True
+                if not waiting:
+                    return None
+                condition.wait(1.0)
+
+    def finished(key, row):
+        ensemble, seed = key
+        row['seed'] = seed
+        with condition:
+            ensemble.running -= 1
+            ensemble.add(row)
+            rows.append(row)
+            if not ensemble.reported and ensemble.converged(options):
+                ensemble.reported = True
+                print('%s converged after %d seeds' % (ensemble.scenario, ensemble.launched))
+            condition.notify_all()
+
+    run_slots(options, next_task, finished)
+    return rows, [ensemble.summary(options) for ensemble in ensembles]
+
+
+COMPARE_COLUMNS = ['scenario', 'metric', 'baseline', 'value', 'relative_difference']
+
+
+def compare(rows, baseline_file, file_name):
+    """
+    Compare the scores with a results table from another run, e.g. a real time run.
+    @return Rows of scenario, metric, both values and the relative difference.
+    """
+    with open(baseline_file) as baseline_input:
+        baseline = dict((row['scenario'], row) for row in csv.DictReader(baseline_input))
+
+    comparisons = []
+    for row in rows:
+        reference = baseline.get(row['scenario'])
+        if reference is None:
+            continue
+        for column in SCORE_COLUMNS:
+            try:
+                value = float(row[column])
+                expected = float(reference[column])
+            except (KeyError, ValueError):
+                continue
+            difference = abs(value - expected) / abs(expected) if expected != 0 else abs(value)
+            comparisons.append({'scenario': row['scenario'], 'metric': column, 'baseline': reference[column],
+                                'value': row[column], 'relative_difference': '%.4f' % difference})
+    write_table(comparisons, file_name, COMPARE_COLUMNS)
+    return comparisons
+
+
+def add_arguments(parser):
+    default_launch_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'launch')
+    parser.add_argument('--jobs', type=int, default=max(multiprocessing.cpu_count() // 4, 1),
+                        help='Scenarios to run at once. Defaults to one per four CPUs.')
+    parser.add_argument('--only', default='', help='Regular expression selecting scenarios.')
+    parser.add_argument('--output', default='scenario_results', help='Directory for logs and results.')
+    parser.add_argument('--launch-dir', dest='launch_dir', default=default_launch_dir)
+    parser.add_argument('--world', default=DEFAULT_WORLD,
+                        help='roslaunch arguments that start Gazebo with the robot.')
+    parser.add_argument('--base-port', dest='base_port', type=int, default=12000,
+                        help='First of the ROS and Gazebo master ports. Each slot uses two.')
+    parser.add_argument('--timeout', type=float, default=3600.0, help='Seconds before a scenario is abandoned.')
+    parser.add_argument('--grace', type=float, default=10.0,
+                        help='Seconds to wait for the remaining scorers after the first result.')
+    parser.add_argument('--no-pin', dest='pin', action='store_false', help='Do not pin scenarios to CPUs.')
+    parser.add_argument('--max-update-rate', dest='max_update_rate', type=float, default=None,
+                        help='Run the world on sim time at this rate in Hz. 0 runs as fast as the CPU allows.')
+    parser.add_argument('--record', action='store_true',
+                        help='Record each scenario to walk.rec in its output directory.')
+    parser.add_argument('--baseline', default='',
+                        help='results.csv of an earlier run, e.g. in real time, to compare the scores with.')
+
+    ensemble = parser.add_argument_group('ensembles', 'Run each scenario with several gauss_seed values.')
+    ensemble.add_argument('--seeds', type=int, default=0,
+                          help='Maximum seeds per scenario. Zero runs each scenario once with its default seed.')
+    ensemble.add_argument('--first-seed', dest='first_seed', type=int, default=5489)
+    ensemble.add_argument('--min-seeds', dest='min_seeds', type=int, default=3,
+                          help='Seeds to run before checking the confidence intervals.')
+    ensemble.add_argument('--seed-batch', dest='seed_batch', type=int, default=0,
+                          help='Seeds of one scenario to run at once. Defaults to --min-seeds.')
+    ensemble.add_argument('--ci-width', dest='ci_width', type=float, default=0.05,
+                          help='Stop once the 95%% interval half width is below this fraction of the mean.')
+    ensemble.add_argument('--stop-metrics', dest='stop_metrics', default='path_deviation,leash_force',
+                          help='Comma separated result columns that must converge.')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Run the launch matrix concurrently.')
+    add_arguments(parser)
+    options = parser.parse_args()
+    options.jobs = max(options.jobs, 1)
+
+    scenarios = find_scenarios(options.launch_dir, options.only)
+    if not scenarios:
+        print('No scenarios to run')
+        return 1
+
+    started = time.time()
+    table = os.path.join(options.output, 'results.csv')
+    if options.seeds > 0:
+        options.stop_metrics = [column for column in options.stop_metrics.split(',') if column]
+        unknown = [column for column in options.stop_metrics if column not in RESULT_COLUMNS]
+        if unknown:
+            print('Unknown stop metrics %s' % ', '.join(unknown))
+            return 1
+        options.min_seeds = max(options.min_seeds, 2)
+        options.seed_batch = options.seed_batch if options.seed_batch > 0 else options.min_seeds
+
+        rows, summaries = run_ensembles(scenarios, options)
+        write_table(rows, table, ['scenario', 'seed', 'status', 'wall_time'] + RESULT_COLUMNS)
+        summary_columns = ['scenario', 'seeds', 'failed', 'converged'] + [
+            column + suffix for column in RESULT_COLUMNS for suffix in ['_mean', '_std', '_ci']]
+        summary_table = os.path.join(options.output, 'ensemble.csv')
+        write_table(summaries, summary_table, summary_columns)
+        print_table(summaries, summary_columns)
+        print('Ran %d seeds of %d scenarios in %.1f s. Results are in %s and %s' % (
+            len(rows), len(scenarios), time.time() - started, table, summary_table))
+    else:
+        rows = run_all([(scenario, None, '') for scenario in scenarios], options)
+        write_table(rows, table)
+        print_table(rows)
+        print('Ran %d scenarios in %.1f s. Results are in %s' % (len(rows), time.time() - started, table))
+
+    if options.baseline:
+        comparison_table = os.path.join(options.output, 'compare.csv')
+        comparisons = compare(rows, options.baseline, comparison_table)
+        print_table(comparisons, COMPARE_COLUMNS)
+        print('Compared %d scores with %s. Comparison is in %s' % (len(comparisons), options.baseline,
+                                                                  comparison_table))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
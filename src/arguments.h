@@ -0,0 +1,78 @@
+#pragma once
+#include <map>
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <boost/lexical_cast.hpp>
+
+namespace {
+
+  //! Arguments of the offline tools by name.
+  typedef std::map<std::string, std::string> Arguments;
+
+  /**
+   * Split name:=value arguments. A leading underscore is ignored so private
+   * parameter syntax from rosrun also works.
+   * @param positional Receives the arguments that are not name:=value. If NULL
+   * they are malformed.
+   * @return False if an argument is malformed.
+   */
+  static bool parseArguments(const int argc, char** argv, Arguments& args,
+          std::vector<std::string>* positional = NULL) {
+      for (int i = 1; i < argc; ++i) {
+          const std::string arg(argv[i]);
+          const size_t separator = arg.find(":=");
+          if (separator == std::string::npos || separator == 0) {
+              if (!positional) {
+                  ROS_ERROR("Expected name:=value but got %s", arg.c_str());
+                  return false;
+              }
+              positional->push_back(arg);
+              continue;
+          }
+          const size_t start = arg[0] == '_' ? 1 : 0;
+          args[arg.substr(start, separator - start)] = arg.substr(separator + 2);
+      }
+      return true;
+  }
+
+  /**
+   * Take an argument out of the arguments. Booleans may be given as true or false.
+   * @throws boost::bad_lexical_cast if the value does not convert.
+   */
+  template<typename T>
+  T getArgument(Arguments& args, const std::string& name, const T defaultValue) {
+      Arguments::iterator i = args.find(name);
+      if (i == args.end()) {
+          return defaultValue;
+      }
+      const std::string value = i->second;
+      args.erase(i);
+      if (value == "true" || value == "false") {
+          return boost::lexical_cast<T>(value == "true");
+      }
+      return boost::lexical_cast<T>(value);
+  }
+
+  template<>
+  std::string getArgument<std::string>(Arguments& args, const std::string& name, const std::string defaultValue) {
+      Arguments::iterator i = args.find(name);
+      if (i == args.end()) {
+          return defaultValue;
+      }
+      const std::string value = i->second;
+      args.erase(i);
+      return value;
+  }
+
+  /**
+   * Log the arguments that were not taken.
+   * @return False if any were left.
+   */
+  static bool checkArgumentsUsed(const Arguments& args) {
+      for (Arguments::const_iterator i = args.begin(); i != args.end(); ++i) {
+          ROS_ERROR("Unknown argument %s", i->first.c_str());
+      }
+      return args.empty();
+  }
+}
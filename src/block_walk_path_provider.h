@@ -1,3 +1,4 @@
+#pragma once
 #include "path_provider.h"
 #include "piecewise_linear_path_provider.h"
 #include <vector>
@@ -9,6 +10,10 @@ namespace {
       public:
         BlockWalkPathProvider(){}
         virtual ~BlockWalkPathProvider(){}
+        virtual void describe(dogsim::PathDescription& description) const {
+            PiecewiseLinearPathProvider::describe(description);
+            description.pathType = "blockwalk";
+        }
       protected:
         virtual std::vector<btVector3> getSegments() const {
             std::vector<btVector3> segments(8);
@@ -7,6 +7,8 @@
 #include <actionlib/client/simple_action_client.h>
 #include <message_filters/subscriber.h>
 #include <dogsim/GetPath.h>
+#include "path_client.h"
+#include "lockstep_client.h"
 #include <actionlib/server/simple_action_server.h>
 
 namespace {
@@ -28,14 +30,19 @@ namespace {
             //! Dog position subscriber
             auto_ptr<message_filters::Subscriber<DogPosition> > dogPositionSub;
 
-            //! Cached service client.
-            ros::ServiceClient getPathClient;
+            //! Local evaluation of the walk.
+            PathClient pathClient;
+
+            //! Holds the world until the queued callbacks have run when in lockstep.
+            LockstepClient lockstep;
 
             bool active;
         public:
             ControlDogPositionBehavior(const string& name):as(nh, name, boost::bind(&ControlDogPositionBehavior::activate, this), false),
                                     actionName(name),
-                                    adjustDogClient("adjust_dog_position_action", true){
+                                    adjustDogClient("adjust_dog_position_action", true),
+                                    pathClient(nh),
+                                    lockstep("control_dog_position_behavior"){
             as.registerPreemptCallback(boost::bind(&ControlDogPositionBehavior::deactivate, this));
             dogPositionSub.reset(
                     new message_filters::Subscriber<DogPosition>(nh,
@@ -43,10 +50,9 @@ namespace {
             dogPositionSub->registerCallback(boost::bind(&ControlDogPositionBehavior::dogPositionCallback, this, _1));
             dogPositionSub->unsubscribe();
             adjustDogClient.waitForServer();
-            getPathClient = nh.serviceClient<GetPath>("/dogsim/get_path", true /* persist */);
-            ros::service::waitForService("/dogsim/get_path");
             active = false;
             as.start();
+            lockstep.acknowledgeFromQueue(nh);
         }
 
         void deactivate(){
@@ -111,12 +117,13 @@ namespace {
         geometry_msgs::PointStamped getDogGoalPosition(const ros::Time& time, bool& started,
                 bool& ended) {
             // Determine the goal.
-            GetPath getPath;
-            getPath.request.time = time;
-            getPathClient.call(getPath);
-            started = getPath.response.started;
-            ended = getPath.response.ended;
-            return getPath.response.point;
+            GetPath::Response path;
+            if (!pathClient.getPath(time, path)) {
+                ROS_DEBUG("No path description received yet");
+            }
+            started = path.started;
+            ended = path.ended;
+            return path.point;
         }
     };
 }
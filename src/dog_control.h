@@ -0,0 +1,46 @@
+#pragma once
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include <ros/ros.h>
+#include <boost/thread/thread.hpp>
+#include <dogsim/utils.h>
+
+namespace {
+
+  const double KD_DEFAULT = 0.15;
+
+  const double KP_DEFAULT = 0.0075;
+
+  const double MAXIMUM_FORCE = 13.5;
+
+  // Rate to run the updates at
+  const double UPDATE_RATE = 0.001;
+
+  const double MIN_DISTANCE_FROM_ROBOT = 0.5;
+  const double BASE_RADIUS = sqrt(2 * utils::square(0.668 / 2.0));
+  const double AVOIDANCE_FORCE_MULT = 1.25;
+
+  //! First and longest delay between checks for a service, in milliseconds.
+  const long SERVICE_WAIT_INITIAL_MS = 10;
+  const long SERVICE_WAIT_MAXIMUM_MS = 2000;
+
+  /**
+   * Wait for a service from a non ROS thread, doubling the delay between checks.
+   * The delay is a boost thread interruption point so the wait can be cancelled.
+   * @return False if ROS shut down first.
+   */
+  static bool waitForServiceWithBackoff(const std::string& serviceName) {
+      ROS_INFO("Waiting for service %s", serviceName.c_str());
+      long delay = SERVICE_WAIT_INITIAL_MS;
+      while (!ros::service::exists(serviceName, false)) {
+          if (!ros::ok()) {
+              return false;
+          }
+          boost::this_thread::sleep(boost::posix_time::milliseconds(delay));
+          delay = std::min(delay * 2, SERVICE_WAIT_MAXIMUM_MS);
+      }
+      ROS_DEBUG("Service %s is available", serviceName.c_str());
+      return true;
+  }
+}
@@ -13,9 +13,18 @@
 #include <dogsim/GetPath.h>
 #include <dogsim/StartPath.h>
 #include <dogsim/MaximumTime.h>
+#include <dogsim/GroundTruth.h>
 #include <tf/tf.h>
 #include <position_tracker/StartMeasurement.h>
 #include <position_tracker/StopMeasurement.h>
+#include <ros/callback_queue.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include "path_client.h"
+#include "gaussian_perturbation.h"
+#include "dog_control.h"
+#include "tick_profiler.h"
+#include "walk_streams.h"
 
 
 namespace {
@@ -23,38 +32,21 @@ namespace {
 using namespace std;
 using namespace gazebo;
 
-const double pi = boost::math::constants::pi<double>();
-
-const double KD_DEFAULT = 0.15;
-
-// Probability of starting a new gaussian in each second
-const double P_NEW_GAUSS_DEFAULT = 0.16;
-
-// Multiple of sigma that captures nearly half of a gaussians width.
-const double GAUSS_HALF_WIDTH = 3;
-
-const double KP_DEFAULT = 0.0075;
-
-const double MAXIMUM_FORCE = 13.5;
-
-// Number of simulator iterations per second.
-const unsigned int SIMULATOR_CYCLES_PER_SECOND = 100;
-
-// Rate to run the updates at
-const double UPDATE_RATE = 0.001;
-
-const double MIN_DISTANCE_FROM_ROBOT = 0.5;
-const double BASE_RADIUS = sqrt(2 * utils::square(0.668 / 2.0));
-const double AVOIDANCE_FORCE_MULT = 1.25;
-
 class DogModelPlugin: public ModelPlugin {
 public:
-    DogModelPlugin() {
+    DogModelPlugin() : ready(false), initialized(false), profiler("dog_model_plugin") {
         ROS_INFO("Creating Dog Plugin");
+        goalStage = profiler.addStage("goal");
+        visualizationStage = profiler.addStage("visualization");
+        avoidanceStage = profiler.addStage("avoidance");
+        forceStage = profiler.addStage("force");
+        groundTruthStage = profiler.addStage("ground_truth");
     }
 
     ~DogModelPlugin() {
         ROS_INFO("Destroying Dog Plugin");
+        initThread.interrupt();
+        initThread.join();
     }
 
     void Load(physics::ModelPtr _parent, sdf::ElementPtr /*_sdf*/) {
@@ -70,16 +62,45 @@ public:
         this->forceX = this->forceY = this->forceZ = 0.0;
         this->appliedForceX = this->appliedForceY = 0.0;
 
-        getPathClient = nh.serviceClient<dogsim::GetPath>("/dogsim/get_path", true);
+        // Path descriptions are delivered on a private queue that is drained from the update loop.
+        pathNh.setCallbackQueue(&pathQueue);
+        pathClient.reset(new PathClient(pathNh));
 
         // Fetch the body link.
         body = this->model->GetLink("body");
 
-        waitForService("/dogsim/get_path");
-        waitForService("/dogsim/start");
-        waitForService("/dogsim/maximum_time");
-
         dogGoalVizPub = nh.advertise<visualization_msgs::Marker>("dogsim/dog_goal_viz", 1);
+        groundTruthPub = nh.advertise<dogsim::GroundTruth>(GROUND_TRUTH_TOPIC, GROUND_TRUTH_QUEUE_SIZE);
+
+        startMeasuringPub = nh.advertise<position_tracker::StartMeasurement>("start_measuring", 1,
+                true);
+        stopMeasuringPub = nh.advertise<position_tracker::StopMeasurement>("stop_measuring", 1,
+                true);
+
+        nh.param<double>("dog_kp", KP, KP_DEFAULT);
+        nh.param<double>("dog_kd", KD, KD_DEFAULT);
+
+        profiler.start(nh);
+
+        // Connect to the path services off the load thread. The dog stays idle until this completes.
+        initThread = boost::thread(&DogModelPlugin::initialize, this);
+
+        // Listen to the update event. This event is broadcast every
+        // simulation iteration.
+        this->updateConnection = event::Events::ConnectWorldUpdateBegin(
+                boost::bind(&DogModelPlugin::OnUpdate, this));
+        ROS_INFO("Loaded the simulated dog");
+    }
+
+private:
+    /**
+     * Wait for the path services, initialize the gaussians and start the path if running solo.
+     */
+    void initialize() {
+        if (!waitForServiceWithBackoff("/dogsim/start")
+                || !waitForServiceWithBackoff("/dogsim/maximum_time")) {
+            return;
+        }
 
         // Initialize the gaussians.
         bool addGaussians;
@@ -88,11 +109,6 @@ public:
             initGaussians();
         }
 
-        startMeasuringPub = nh.advertise<position_tracker::StartMeasurement>("start_measuring", 1,
-                true);
-        stopMeasuringPub = nh.advertise<position_tracker::StopMeasurement>("stop_measuring", 1,
-                true);
-
         // Start the path if we are in solo mode. In regular mode the robot does this.
         bool isSoloDog;
         nh.param<bool>("solo_dog", isSoloDog, false);
@@ -104,25 +120,20 @@ public:
             startPath();
         }
 
-        nh.param<double>("dog_kp", KP, KP_DEFAULT);
-        nh.param<double>("dog_kd", KD, KD_DEFAULT);
-
-        // Listen to the update event. This event is broadcast every
-        // simulation iteration.
-        this->updateConnection = event::Events::ConnectWorldUpdateBegin(
-                boost::bind(&DogModelPlugin::OnUpdate, this));
+        boost::mutex::scoped_lock lock(readyMutex);
+        ready = true;
         ROS_INFO("Completed initializing the simulated dog");
     }
 
-private:
     /**
-     * This is not a standard ROS thread, so waitForService does not work. Mimic it with a simple spin-wait.
+     * Whether initialization has completed. Only locks until it has.
      */
-    void waitForService(const string& serviceName) {
-        while (!ros::service::exists(serviceName, false)) {
-            // Spin-wait
-            ROS_INFO("Waiting for service %s", serviceName.c_str());
+    bool isInitialized() {
+        if (!initialized) {
+            boost::mutex::scoped_lock lock(readyMutex);
+            initialized = ready;
         }
+        return initialized;
     }
 
     void startPath() {
@@ -136,6 +147,21 @@ private:
     }
 
     void initGaussians() {
+        // Reuse a table exported by an earlier run rather than generating the gaussians.
+        string tableFile;
+        nh.param<string>("gauss_offset_table", tableFile, "");
+        if (!tableFile.empty() && nh.hasParam("gauss_seed")) {
+            // The table holds one seed's gaussians, so every seed of an ensemble would repeat them.
+            ROS_ERROR("Ignoring gauss_offset_table %s because gauss_seed is set", tableFile.c_str());
+        }
+        else if (!tableFile.empty()) {
+            if (perturbation.load(tableFile)) {
+                ROS_INFO("Loaded gaussian offset table from %s", tableFile.c_str());
+                return;
+            }
+            ROS_ERROR("Falling back to generating gaussians");
+        }
+
         dogsim::MaximumTime maxTime;
         ros::ServiceClient maxTimeClient = nh.serviceClient<dogsim::MaximumTime>(
                 "/dogsim/maximum_time", false);
@@ -143,52 +169,55 @@ private:
             ROS_ERROR("Failed to call maximum time");
         }
 
-        // Determine if we should start a new gaussian.
-        boost::uniform_real<> randomZeroToOne(0, 1);
-
-        double pNewGauss;
-        nh.param<double>("p_new_gauss", pNewGauss, P_NEW_GAUSS_DEFAULT);
-        double gaussHeight;
-        nh.param<double>("gauss_height", gaussHeight, 1.0);
-        double gaussMinWidth;
-        nh.param<double>("gauss_min_width", gaussMinWidth, 0.5);
-        double gaussMaxWidth;
-        nh.param<double>("gauss_max_width", gaussMaxWidth, 8.0);
+        GaussianParameters params;
+        nh.param<double>("p_new_gauss", params.pNewGauss, P_NEW_GAUSS_DEFAULT);
+        nh.param<double>("gauss_height", params.gaussHeight, 1.0);
+        nh.param<double>("gauss_min_width", params.gaussMinWidth, 0.5);
+        nh.param<double>("gauss_max_width", params.gaussMaxWidth, 8.0);
         ROS_INFO(
                 "Gaussian parameters -  pNewGauss: %f gaussHeight: %f gaussMinWidth: %f gaussMaxWidth: %f",
-                pNewGauss, gaussHeight, gaussMinWidth, gaussMaxWidth);
+                params.pNewGauss, params.gaussHeight, params.gaussMinWidth, params.gaussMaxWidth);
+
+        // Runs with the same seed see the same gaussians. Vary it to sample an ensemble.
+        int seed;
+        nh.param<int>("gauss_seed", seed, GAUSS_SEED_DEFAULT);
+        rng.seed(static_cast<unsigned int>(seed));
 
-        ROS_INFO("Initializing gaussians. Maximum time is %f",
+        ROS_INFO("Initializing gaussians with seed %d. Maximum time is %f", seed,
                 maxTime.response.maximumTime.toSec());
-        // Precompute all the lissajous cycles.
-        for (double t = 0; t <= maxTime.response.maximumTime.toSec();
-                t += 1.0 / SIMULATOR_CYCLES_PER_SECOND) {
-            if (randomZeroToOne(rng)
-                    < pNewGauss / static_cast<double>(SIMULATOR_CYCLES_PER_SECOND)) {
-                // Create a structure with the parameters.
-                GaussParams params;
-                boost::uniform_real<> randomA(-gaussHeight * pi, gaussHeight * pi);
-                params.a = randomA(rng);
-
-                boost::uniform_real<> randomC(gaussMinWidth * pi, gaussMaxWidth * pi);
-                params.c = randomC(rng);
-
-                ROS_DEBUG("New gaussian created with a: %f c: %f at time %f", params.a, params.c,
-                        t);
-                params.startTime = t;
-                gaussParams.push_back(params);
-            }
+        perturbation.generate(rng, maxTime.response.maximumTime.toSec(), params);
+        ROS_INFO("Completed initializing gaussians. Total gaussians is %lu", perturbation.getGaussianCount());
+
+        // Optionally replace the per tick evaluation with a table lookup, and share the table
+        // so the goal trajectory can be reproduced offline.
+        bool precompute;
+        nh.param<bool>("precompute_gauss_offsets", precompute, false);
+        string exportFile;
+        nh.param<string>("export_gauss_offset_table", exportFile, "");
+        if (precompute || !exportFile.empty()) {
+            perturbation.precompute(maxTime.response.maximumTime.toSec());
+        }
+        if (!exportFile.empty() && perturbation.save(exportFile)) {
+            ROS_INFO("Exported gaussian offset table to %s", exportFile.c_str());
         }
-        ROS_INFO("Completed initializing gaussians. Total gaussians is %lu", gaussParams.size());
     }
 
     // Called by the world update start event
     void OnUpdate() {
+        if (!isInitialized()) {
+            return;
+        }
+        StageTimer tickTimer(profiler, TICK_STAGE);
+
         // Calculate the desired position.
         common::Time currTime = this->model->GetWorld()->GetSimTime();
         if (currTime.Double() - this->previousTime.Double() >= UPDATE_RATE) {
+            publishGroundTruth(currTime);
+
             bool running, ended;
+            StageTimer goalTimer(profiler, goalStage);
             math::Vector3 goalPosition = calcGoalPosition(currTime, running, ended);
+            goalTimer.stop();
             if(ended){
                 ROS_INFO("Stopping dog model movement");
                 // Stop updates.
@@ -209,6 +238,7 @@ private:
 
 
             // Publish the position.
+            StageTimer visualizationTimer(profiler, visualizationStage);
             if(dogGoalVizPub.getNumSubscribers() > 0) {
                 std_msgs::ColorRGBA RED = utils::createColor(1, 0, 0);
                 geometry_msgs::PointStamped goalPoint;
@@ -220,6 +250,7 @@ private:
                 dogGoalVizPub.publish(
                         utils::createMarker(goalPoint.point, goalPoint.header, RED, true));
             }
+            visualizationTimer.stop();
 
             // Calculate current errors
             const math::Vector3 worldPose = this->model->GetWorldPose().pos;
@@ -262,6 +293,7 @@ private:
 
             // Add force to push dog away from base of robot.
             // y = 2 * MAX_FORCE * 1/0.25^2 * (0.25 - x).^2
+            StageTimer avoidanceTimer(profiler, avoidanceStage);
             const physics::ModelPtr robot = this->model->GetWorld()->GetModel("pr2");
 
             double avoidanceForceX = 0;
@@ -297,6 +329,8 @@ private:
             ROS_DEBUG("Applied force X: %f, Applied force Y: %f", this->appliedForceX, this->appliedForceY);
         }
 
+        StageTimer forceTimer(profiler, forceStage);
+
         // Ensure the dog didn't get lifted. Can't apply force if it did. Apply a smoothing function
         // such that there is 100% traction at 0.05 height and 0% traction at 0.2 height.
         // TODO: This is altered by changing the height of the dog.
@@ -314,6 +348,40 @@ private:
     }
 
 private:
+    /**
+     * Publish the poses stamped with the sim time of this update, so scorers do not
+     * have to guess the time from the clock when they handle them.
+     */
+    void publishGroundTruth(const common::Time& time) {
+        if (groundTruthPub.getNumSubscribers() == 0) {
+            return;
+        }
+        StageTimer groundTruthTimer(profiler, groundTruthStage);
+        dogsim::GroundTruthPtr truth(new dogsim::GroundTruth());
+        truth->header.stamp = ros::Time(time.Double());
+        truth->header.frame_id = "/map";
+        truth->hasDog = true;
+        truth->dogName = this->model->GetName();
+        toPose(this->model->GetWorldPose(), truth->dog);
+
+        const physics::ModelPtr robot = this->model->GetWorld()->GetModel("pr2");
+        truth->hasRobot = robot.get() != NULL;
+        if (robot) {
+            toPose(robot->GetWorldPose(), truth->robot);
+        }
+        groundTruthPub.publish(truth);
+    }
+
+    static void toPose(const math::Pose& pose, geometry_msgs::Pose& result) {
+        result.position.x = pose.pos.x;
+        result.position.y = pose.pos.y;
+        result.position.z = pose.pos.z;
+        result.orientation.w = pose.rot.w;
+        result.orientation.x = pose.rot.x;
+        result.orientation.y = pose.rot.y;
+        result.orientation.z = pose.rot.z;
+    }
+
     static double calcError(const double _currentPosition, const double _goalPosition) {
         return _goalPosition - _currentPosition;
     }
@@ -328,11 +396,13 @@ private:
     }
 
     math::Vector3 calcGoalPosition(common::Time time, bool& running, bool& ended) {
-        dogsim::GetPath getPath;
-        getPath.request.time = ros::Time(time.Double());
-        getPathClient.call(getPath);
-        if (!getPath.response.started || getPath.response.ended) {
-            ended = getPath.response.ended;
+        // Pick up any change to the path or its start time.
+        pathQueue.callAvailable();
+
+        dogsim::GetPath::Response path;
+        pathClient->getPath(ros::Time(time.Double()), path);
+        if (!path.started || path.ended) {
+            ended = path.ended;
             running = false;
             return math::Vector3();
         }
@@ -342,13 +412,12 @@ private:
 
         // Check the goal for the current time.
         gazebo::math::Vector3 base;
-        base.x = getPath.response.point.point.x;
-        base.y = getPath.response.point.point.y;
-        base.z = getPath.response.point.point.z;
+        base.x = path.point.point.x;
+        base.y = path.point.point.y;
+        base.z = path.point.point.z;
 
         // Gaussian function is tuned for input = [1:700]
-        math::Vector3 result = addGaussians(base, this->previousBase,
-                getPath.response.elapsedTime.sec);
+        math::Vector3 result = addGaussians(base, this->previousBase, path.elapsedTime.sec);
         this->previousBase = base;
         return result;
     }
@@ -358,51 +427,7 @@ private:
 
         // Start with the base vector
         math::Vector3 result = base;
-
-        // Calculate the derivative
-        double dx = 0;
-        double dy = 0;
-        if (t > 0) {
-            dx = base.x - previousBase.x;
-            dy = base.y - previousBase.y;
-        }
-
-        // Calculate the normal
-        double rx = dy;
-        double ry = -dx;
-
-        // Calculate the unit vector.
-        double rl = sqrt(utils::square(rx) + utils::square(ry));
-        double rux;
-        double ruy;
-        if (rl > 0) {
-            rux = rx / rl;
-            ruy = ry / rl;
-        }
-        else {
-            rux = rx;
-            ruy = ry;
-        }
-
-        // Iterate over all gaussians.
-        for (unsigned int i = 0; i < gaussParams.size(); ++i) {
-            // Start times are strictly increasing.
-            if (t < gaussParams[i].startTime) {
-                break;
-            }
-
-            double gx = t - gaussParams[i].startTime - GAUSS_HALF_WIDTH * gaussParams[i].c;
-            double gy = gaussParams[i].a
-                    * exp(-(utils::square(gx) / (2 * utils::square(gaussParams[i].c))));
-
-            // Calculate the normal vector.
-            double nx = rux * gy;
-            double ny = ruy * gy;
-
-            // Add it to the result.
-            result.x += nx;
-            result.y += ny;
-        }
+        perturbation.perturb(t, previousBase.x, previousBase.y, result.x, result.y);
         return result;
     }
 
@@ -439,13 +464,12 @@ private:
     // Previous goal
     math::Vector3 previousBase;
 
-    struct GaussParams {
-        double a;
-        double c;
-        double startTime;
-    };
+    //! Node handle and queue for the path description subscription.
+    ros::NodeHandle pathNh;
+    ros::CallbackQueue pathQueue;
 
-    ros::ServiceClient getPathClient;
+    //! Local evaluation of the walk.
+    auto_ptr<PathClient> pathClient;
 
     ros::ServiceServer dogOrientationService;
 
@@ -455,14 +479,32 @@ private:
 
     physics::LinkPtr body;
 
-    // Parameters for all operating gaussians
-    vector<GaussParams> gaussParams;
+    //! Gaussians that push the dog off the path.
+    GaussianPerturbation perturbation;
+
+    //! Connects to the path services and initializes the gaussians.
+    boost::thread initThread;
+
+    //! Set by the init thread once the dog can run. Guarded by readyMutex.
+    bool ready;
+    boost::mutex readyMutex;
+
+    //! Update thread copy of ready. Once true it never changes, so no lock is needed.
+    bool initialized;
+
+    //! Wall time spent in each update and its stages.
+    TickProfiler profiler;
+    unsigned int goalStage;
+    unsigned int visualizationStage;
+    unsigned int avoidanceStage;
+    unsigned int forceStage;
+    unsigned int groundTruthStage;
 
-    // Pseudo random number generator. This will always use the same seed
-    // so that every run is the same.
+    // Pseudo random number generator. Seeded from gauss_seed so that runs are repeatable.
     boost::mt19937 rng;
 
     ros::Publisher dogGoalVizPub;
+    ros::Publisher groundTruthPub;
 
     // KP term
     double KP;
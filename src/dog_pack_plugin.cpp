@@ -0,0 +1,444 @@
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <ros/ros.h>
+#include <gazebo/gazebo.hh>
+#include <physics/physics.hh>
+#include <physics/Model.hh>
+#include <common/common.hh>
+#include <dogsim/utils.h>
+#include <dogsim/GetPath.h>
+#include <dogsim/StartPath.h>
+#include <dogsim/MaximumTime.h>
+#include <position_tracker/StartMeasurement.h>
+#include <position_tracker/StopMeasurement.h>
+#include <ros/callback_queue.h>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include "path_client.h"
+#include "gaussian_perturbation.h"
+#include "dog_control.h"
+#include "tick_profiler.h"
+
+namespace {
+
+using namespace std;
+using namespace gazebo;
+
+/**
+ * Drives a pack of dog models from a single world update callback. Attach to a
+ * controller model and list the dogs in the dog_pack parameter, e.g.
+ *
+ *   dog_pack: [{model: dog_0, session: walk_0, seed: 1}, {model: dog_1, session: walk_1, seed: 2}]
+ *
+ * Each dog follows its own get path server session and its own gaussians. The dog
+ * models must not load the dog model plugin themselves.
+ */
+class DogPackPlugin: public ModelPlugin {
+public:
+    DogPackPlugin() : isSoloDog(false), ready(false), initialized(false), profiler("dog_pack_plugin") {
+        ROS_INFO("Creating Dog Pack Plugin");
+        controlStage = profiler.addStage("control");
+        forceStage = profiler.addStage("force");
+    }
+
+    ~DogPackPlugin() {
+        ROS_INFO("Destroying Dog Pack Plugin");
+        initThread.interrupt();
+        initThread.join();
+    }
+
+    void Load(physics::ModelPtr _parent, sdf::ElementPtr /*_sdf*/) {
+        ROS_INFO("Loading Dog Pack Plugin");
+        this->world = _parent->GetWorld();
+
+        // Save the start time.
+        this->previousTime = this->world->GetSimTime();
+
+        // Path descriptions for every dog are delivered on a private queue that is drained from the update loop.
+        pathNh.setCallbackQueue(&pathQueue);
+
+        if (!loadDogs()) {
+            return;
+        }
+
+        startMeasuringPub = nh.advertise<position_tracker::StartMeasurement>("start_measuring", 1,
+                true);
+        stopMeasuringPub = nh.advertise<position_tracker::StopMeasurement>("stop_measuring", 1,
+                true);
+
+        nh.param<bool>("solo_dog", isSoloDog, false);
+        nh.param<double>("dog_kp", KP, KP_DEFAULT);
+        nh.param<double>("dog_kd", KD, KD_DEFAULT);
+
+        profiler.start(nh);
+
+        // Connect to the path services off the load thread. The pack stays idle until this completes.
+        initThread = boost::thread(&DogPackPlugin::initialize, this);
+
+        // Listen to the update event. This event is broadcast every
+        // simulation iteration.
+        this->updateConnection = event::Events::ConnectWorldUpdateBegin(
+                boost::bind(&DogPackPlugin::OnUpdate, this));
+        ROS_INFO("Loaded a pack of %lu simulated dogs", modelNames.size());
+    }
+
+private:
+    /**
+     * Wait for the path services, initialize the gaussians and start the paths if running solo.
+     */
+    void initialize() {
+        if (!waitForServiceWithBackoff("/dogsim/start")
+                || !waitForServiceWithBackoff("/dogsim/maximum_time")) {
+            return;
+        }
+
+        // Initialize the gaussians.
+        bool addGaussians;
+        nh.param<bool>("add_gaussians_to_path", addGaussians, true);
+        if (addGaussians) {
+            initGaussians();
+        }
+
+        // Start the paths if we are in solo mode. In regular mode the robot does this.
+        if (isSoloDog) {
+            // Notify clients to start measuring.
+            position_tracker::StartMeasurement startMeasuringMsg;
+            startMeasuringMsg.header.stamp = ros::Time::now();
+            startMeasuringPub.publish(startMeasuringMsg);
+            for (unsigned int i = 0; i < sessions.size(); ++i) {
+                startPath(sessions[i]);
+            }
+        }
+
+        boost::mutex::scoped_lock lock(readyMutex);
+        ready = true;
+        ROS_INFO("Completed initializing the pack of simulated dogs");
+    }
+
+    /**
+     * Whether initialization has completed. Only locks until it has.
+     */
+    bool isInitialized() {
+        if (!initialized) {
+            boost::mutex::scoped_lock lock(readyMutex);
+            initialized = ready;
+        }
+        return initialized;
+    }
+
+    /**
+     * Read the dogs from the dog_pack parameter and size the per dog state.
+     */
+    bool loadDogs() {
+        XmlRpc::XmlRpcValue pack;
+        if (!nh.getParam("dog_pack", pack) || pack.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+            ROS_ERROR("Parameter dog_pack must be a list of dogs");
+            return false;
+        }
+
+        for (int i = 0; i < pack.size(); ++i) {
+            XmlRpc::XmlRpcValue& dog = pack[i];
+            if (dog.getType() != XmlRpc::XmlRpcValue::TypeStruct || !dog.hasMember("model")) {
+                ROS_ERROR("Dog %d in dog_pack has no model name", i);
+                return false;
+            }
+            modelNames.push_back(static_cast<string>(dog["model"]));
+            sessions.push_back(dog.hasMember("session") ? static_cast<string>(dog["session"]) : string());
+            seeds.push_back(dog.hasMember("seed") ? static_cast<int>(dog["seed"]) : GAUSS_SEED_DEFAULT + i);
+            pathClients.push_back(boost::shared_ptr<PathClient>(new PathClient(pathNh, sessions.back())));
+            ROS_INFO("Dog %s follows the %s walk", modelNames.back().c_str(),
+                    sessions.back().empty() ? "default" : sessions.back().c_str());
+        }
+
+        const size_t count = modelNames.size();
+        bodies.resize(count);
+        perturbations.resize(count);
+        previousBaseX.resize(count, 0.0);
+        previousBaseY.resize(count, 0.0);
+        goalX.resize(count, 0.0);
+        goalY.resize(count, 0.0);
+        positionX.resize(count, 0.0);
+        positionY.resize(count, 0.0);
+        previousErrorX.resize(count, 0.0);
+        previousErrorY.resize(count, 0.0);
+        forceX.resize(count, 0.0);
+        forceY.resize(count, 0.0);
+        appliedForceX.resize(count, 0.0);
+        appliedForceY.resize(count, 0.0);
+        running.resize(count, 0);
+        ended.resize(count, 0);
+        return true;
+    }
+
+    void startPath(const string& session) {
+        dogsim::StartPath startPath;
+        startPath.request.session = session;
+        startPath.request.time = ros::Time(this->world->GetSimTime().Double());
+        ros::ServiceClient startPathClient = nh.serviceClient<dogsim::StartPath>("/dogsim/start",
+                false);
+        if (!startPathClient.call(startPath)) {
+            ROS_ERROR("Failed to start path for session %s", session.c_str());
+        }
+    }
+
+    void initGaussians() {
+        GaussianParameters params;
+        nh.param<double>("p_new_gauss", params.pNewGauss, P_NEW_GAUSS_DEFAULT);
+        nh.param<double>("gauss_height", params.gaussHeight, 1.0);
+        nh.param<double>("gauss_min_width", params.gaussMinWidth, 0.5);
+        nh.param<double>("gauss_max_width", params.gaussMaxWidth, 8.0);
+
+        ros::ServiceClient maxTimeClient = nh.serviceClient<dogsim::MaximumTime>(
+                "/dogsim/maximum_time", false);
+        for (unsigned int i = 0; i < modelNames.size(); ++i) {
+            dogsim::MaximumTime maxTime;
+            maxTime.request.session = sessions[i];
+            if (!maxTimeClient.call(maxTime)) {
+                ROS_ERROR("Failed to call maximum time for session %s", sessions[i].c_str());
+            }
+
+            boost::mt19937 rng(seeds[i]);
+            perturbations[i].generate(rng, maxTime.response.maximumTime.toSec(), params);
+            ROS_INFO("Initialized %lu gaussians for dog %s", perturbations[i].getGaussianCount(),
+                    modelNames[i].c_str());
+        }
+    }
+
+    // Called by the world update start event
+    void OnUpdate() {
+        if (!isInitialized()) {
+            return;
+        }
+        StageTimer tickTimer(profiler, TICK_STAGE);
+
+        common::Time currTime = this->world->GetSimTime();
+        if (currTime.Double() - this->previousTime.Double() >= UPDATE_RATE) {
+            StageTimer controlTimer(profiler, controlStage);
+            updateControl(currTime);
+            controlTimer.stop();
+            if (allEnded()) {
+                ROS_INFO("Stopping dog pack movement");
+                // Stop updates.
+                event::Events::DisconnectWorldUpdateBegin(this->updateConnection);
+                if (isSoloDog) {
+                    // Notify clients to stop measuring.
+                    position_tracker::StopMeasurement stopMeasuringMsg;
+                    stopMeasuringMsg.header.stamp = ros::Time::now();
+                    stopMeasuringPub.publish(stopMeasuringMsg);
+                }
+                return;
+            }
+        }
+        StageTimer forceTimer(profiler, forceStage);
+        applyForces();
+    }
+
+    /**
+     * Recompute the goals and forces of every dog.
+     */
+    void updateControl(const common::Time& currTime) {
+        // Pick up any change to the paths or their start times.
+        pathQueue.callAvailable();
+
+        const double deltat = (currTime - this->previousTime).Double();
+        this->previousTime = currTime;
+
+        // Gather the goals and positions.
+        const ros::Time time(currTime.Double());
+        for (unsigned int i = 0; i < bodies.size(); ++i) {
+            running[i] = findBody(i) && calcGoalPosition(i, time);
+            if (running[i]) {
+                const math::Vector3 worldPose = bodies[i]->GetModel()->GetWorldPose().pos;
+                positionX[i] = worldPose.x;
+                positionY[i] = worldPose.y;
+            }
+        }
+
+        // PD control of every dog. Dogs that are not running keep their state.
+        const size_t count = bodies.size();
+        for (size_t i = 0; i < count; ++i) {
+            const double errorX = goalX[i] - positionX[i];
+            const double errorY = goalY[i] - positionY[i];
+            const double outputX = KP * errorX + KD * (errorX - previousErrorX[i]) / deltat;
+            const double outputY = KP * errorY + KD * (errorY - previousErrorY[i]) / deltat;
+
+            // Limit the force. This should only happen when the leash is binding.
+            const double newForceX = max(-MAXIMUM_FORCE, min(MAXIMUM_FORCE, forceX[i] + outputX));
+            const double newForceY = max(-MAXIMUM_FORCE, min(MAXIMUM_FORCE, forceY[i] + outputY));
+
+            forceX[i] = running[i] ? newForceX : forceX[i];
+            forceY[i] = running[i] ? newForceY : forceY[i];
+            previousErrorX[i] = running[i] ? errorX : previousErrorX[i];
+            previousErrorY[i] = running[i] ? errorY : previousErrorY[i];
+        }
+
+        // Add force to push the dogs away from base of robot.
+        // y = 2 * MAX_FORCE * 1/0.25^2 * (0.25 - x).^2
+        const physics::ModelPtr robot = this->world->GetModel("pr2");
+        bool hasRobot = false;
+        double baseX = 0;
+        double baseY = 0;
+        if (robot) {
+            const math::Vector3 basePosition = robot->GetLink("base_footprint")->GetWorldPose().pos;
+            hasRobot = true;
+            baseX = basePosition.x;
+            baseY = basePosition.y;
+        }
+
+        const double maximumAppliedForce = AVOIDANCE_FORCE_MULT * MAXIMUM_FORCE;
+        for (size_t i = 0; i < count; ++i) {
+            const double diffX = positionX[i] - baseX;
+            const double diffY = positionY[i] - baseY;
+            const double distance = sqrt(utils::square(diffX) + utils::square(diffY));
+            const double clearance = max(distance - BASE_RADIUS, 0.0);
+            const double avoidanceForce = hasRobot && clearance < MIN_DISTANCE_FROM_ROBOT && distance > 0 ?
+                    AVOIDANCE_FORCE_MULT * MAXIMUM_FORCE / utils::square(MIN_DISTANCE_FROM_ROBOT)
+                            * utils::square(MIN_DISTANCE_FROM_ROBOT - clearance) / distance : 0.0;
+
+            appliedForceX[i] = max(-maximumAppliedForce,
+                    min(maximumAppliedForce, forceX[i] + avoidanceForce * diffX));
+            appliedForceY[i] = max(-maximumAppliedForce,
+                    min(maximumAppliedForce, forceY[i] + avoidanceForce * diffY));
+        }
+    }
+
+    /**
+     * Apply the last computed forces to every running dog.
+     */
+    void applyForces() {
+        for (unsigned int i = 0; i < bodies.size(); ++i) {
+            if (!running[i]) {
+                continue;
+            }
+
+            // Ensure the dog didn't get lifted. Can't apply force if it did. Apply a smoothing function
+            // such that there is 100% traction at 0.05 height and 0% traction at 0.2 height.
+            const physics::LinkPtr& body = bodies[i];
+            double liftFactor = min(log(10 * (body->GetModel()->GetWorldPose().pos.z)) / log(10 * 0.05),
+                    1.0);
+            body->AddForce(math::Vector3(appliedForceX[i] * liftFactor, appliedForceY[i] * liftFactor, 0.0));
+
+            // Calculate the torque
+            const math::Vector3 relativeForce = body->GetRelativeForce();
+            body->AddRelativeTorque(math::Vector3(0.0, 0.0, atan2(relativeForce.y, relativeForce.x) / (3 * pi)));
+        }
+    }
+
+    /**
+     * Look up the body of a dog. Dogs may be spawned after the pack controller.
+     */
+    bool findBody(const unsigned int i) {
+        if (!bodies[i]) {
+            const physics::ModelPtr model = this->world->GetModel(modelNames[i]);
+            if (model) {
+                bodies[i] = model->GetLink("body");
+            }
+        }
+        return bodies[i].get() != NULL;
+    }
+
+    /**
+     * Calculate the goal of a dog.
+     * @return True if the dog's walk is running.
+     */
+    bool calcGoalPosition(const unsigned int i, const ros::Time& time) {
+        dogsim::GetPath::Response path;
+        if (!pathClients[i]->getPath(time, path) || !path.started || path.ended) {
+            ended[i] = path.ended;
+            return false;
+        }
+
+        double x = path.point.point.x;
+        double y = path.point.point.y;
+
+        // Gaussian function is tuned for input = [1:700]
+        perturbations[i].perturb(path.elapsedTime.sec, previousBaseX[i], previousBaseY[i], x, y);
+        previousBaseX[i] = path.point.point.x;
+        previousBaseY[i] = path.point.point.y;
+
+        goalX[i] = x;
+        goalY[i] = y;
+        return true;
+    }
+
+    bool allEnded() const {
+        for (unsigned int i = 0; i < ended.size(); ++i) {
+            if (!ended[i]) {
+                return false;
+            }
+        }
+        return !ended.empty();
+    }
+
+    //! ROS node handle
+    ros::NodeHandle nh;
+
+    physics::WorldPtr world;
+
+    // Pointer to the update event connection
+    event::ConnectionPtr updateConnection;
+
+    // Previous iteration's time
+    common::Time previousTime;
+
+    //! Node handle and queue for the path description subscriptions.
+    ros::NodeHandle pathNh;
+    ros::CallbackQueue pathQueue;
+
+    //! Publishers for starting and stopping measurement.
+    ros::Publisher startMeasuringPub;
+    ros::Publisher stopMeasuringPub;
+
+    bool isSoloDog;
+
+    //! Configuration of each dog.
+    vector<string> modelNames;
+    vector<string> sessions;
+    vector<unsigned int> seeds;
+
+    //! Per dog resources. NULL bodies have not been spawned yet.
+    vector<physics::LinkPtr> bodies;
+    vector<boost::shared_ptr<PathClient> > pathClients;
+    vector<GaussianPerturbation> perturbations;
+
+    //! Per dog control state stored as parallel arrays so the control loops vectorize.
+    vector<double> previousBaseX;
+    vector<double> previousBaseY;
+    vector<double> goalX;
+    vector<double> goalY;
+    vector<double> positionX;
+    vector<double> positionY;
+    vector<double> previousErrorX;
+    vector<double> previousErrorY;
+    vector<double> forceX;
+    vector<double> forceY;
+    vector<double> appliedForceX;
+    vector<double> appliedForceY;
+    vector<unsigned char> running;
+    vector<unsigned char> ended;
+
+    //! Connects to the path services and initializes the gaussians.
+    boost::thread initThread;
+
+    //! Set by the init thread once the pack can run. Guarded by readyMutex.
+    bool ready;
+    boost::mutex readyMutex;
+
+    //! Update thread copy of ready. Once true it never changes, so no lock is needed.
+    bool initialized;
+
+    //! Wall time spent in each update and its stages.
+    TickProfiler profiler;
+    unsigned int controlStage;
+    unsigned int forceStage;
+
+    // KP term
+    double KP;
+
+    // KD term
+    double KD;
+};
+
+// Register this plugin with the simulator
+GZ_REGISTER_MODEL_PLUGIN (DogPackPlugin);
+}
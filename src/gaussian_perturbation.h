@@ -0,0 +1,292 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cmath>
+#include <limits>
+#include <ros/ros.h>
+#include <boost/math/constants/constants.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real.hpp>
+#include <dogsim/utils.h>
+
+namespace {
+
+  // Multiple of sigma that captures nearly half of a gaussians width.
+  const double GAUSS_HALF_WIDTH = 3;
+
+  // Multiple of sigma past the peak after which a gaussian is below double precision
+  // of its height and can be skipped. exp(-9^2 / 2) is about 2.6e-18.
+  const double GAUSS_CUTOFF_WIDTH = 9;
+
+  // Number of chances per second to start a new gaussian.
+  const unsigned int GAUSS_CYCLES_PER_SECOND = 100;
+
+  // Probability of starting a new gaussian in each second
+  const double P_NEW_GAUSS_DEFAULT = 0.16;
+
+  // Default seed of the gaussians. The default seed of boost::mt19937, used before it was a parameter.
+  const unsigned int GAUSS_SEED_DEFAULT = 5489u;
+
+  // Default spacing of the precomputed offsets. The walk is perturbed at whole seconds.
+  const double GAUSS_TABLE_STEP_DEFAULT = 1.0;
+
+  /**
+   * Parameters controlling how often and how large the perturbations are.
+   */
+  struct GaussianParameters {
+      GaussianParameters() :
+          pNewGauss(P_NEW_GAUSS_DEFAULT), gaussHeight(1.0), gaussMinWidth(0.5), gaussMaxWidth(8.0) {
+      }
+
+      double pNewGauss;
+      double gaussHeight;
+      double gaussMinWidth;
+      double gaussMaxWidth;
+  };
+
+  /**
+   * Sum of randomly placed gaussians used to push the dog off the path. The sum is
+   * the scalar offset along the normal of the path.
+   */
+  class GaussianPerturbation {
+    public:
+      GaussianPerturbation() :
+          nextGauss(0), activeGaussTime(0.0), tableStep(GAUSS_TABLE_STEP_DEFAULT) {
+      }
+
+      /**
+       * Place gaussians over the walk. The same generator state always yields the same gaussians.
+       */
+      void generate(boost::mt19937& rng, const double maximumTime, const GaussianParameters& params) {
+          const double pi = boost::math::constants::pi<double>();
+          boost::uniform_real<> randomZeroToOne(0, 1);
+
+          gaussParams.clear();
+          resetWindow();
+          for (double t = 0; t <= maximumTime; t += 1.0 / GAUSS_CYCLES_PER_SECOND) {
+              if (randomZeroToOne(rng) < params.pNewGauss / static_cast<double>(GAUSS_CYCLES_PER_SECOND)) {
+                  // Create a structure with the parameters.
+                  GaussParams gauss;
+                  boost::uniform_real<> randomA(-params.gaussHeight * pi, params.gaussHeight * pi);
+                  gauss.a = randomA(rng);
+
+                  boost::uniform_real<> randomC(params.gaussMinWidth * pi, params.gaussMaxWidth * pi);
+                  gauss.c = randomC(rng);
+
+                  ROS_DEBUG("New gaussian created with a: %f c: %f at time %f", gauss.a, gauss.c, t);
+                  gauss.startTime = t;
+                  gauss.endTime = t + (GAUSS_HALF_WIDTH + GAUSS_CUTOFF_WIDTH) * gauss.c;
+                  gaussParams.push_back(gauss);
+              }
+          }
+      }
+
+      size_t getGaussianCount() const {
+          return gaussParams.size();
+      }
+
+      bool hasTable() const {
+          return !offsets.empty();
+      }
+
+      /**
+       * Offset along the normal at time t. Uses the table if one was precomputed or loaded.
+       */
+      double offsetAt(const double t) {
+          return hasTable() ? lookupOffset(t) : evaluateOffset(t);
+      }
+
+      /**
+       * Push the goal (x, y) along the normal of the direction it moved from the previous goal.
+       */
+      void perturb(const double t, const double previousX, const double previousY, double& x, double& y) {
+          // Calculate the derivative
+          double dx = 0;
+          double dy = 0;
+          if (t > 0) {
+              dx = x - previousX;
+              dy = y - previousY;
+          }
+
+          // Calculate the normal
+          double rx = dy;
+          double ry = -dx;
+
+          // Calculate the unit vector.
+          double rl = sqrt(utils::square(rx) + utils::square(ry));
+          if (rl > 0) {
+              rx /= rl;
+              ry /= rl;
+          }
+
+          // Add the offset along the normal.
+          const double offset = offsetAt(t);
+          x += rx * offset;
+          y += ry * offset;
+      }
+
+      /**
+       * Evaluate the offsets from time 0 to maximumTime every step seconds.
+       */
+      void precompute(const double maximumTime, const double step = GAUSS_TABLE_STEP_DEFAULT) {
+          const size_t count = static_cast<size_t>(std::ceil(maximumTime / step)) + 1;
+          std::vector<double> table(count);
+          for (size_t i = 0; i < count; ++i) {
+              table[i] = evaluateOffset(i * step);
+          }
+          tableStep = step;
+          offsets.swap(table);
+      }
+
+      /**
+       * Load a table written by save.
+       * @return False if the file could not be read.
+       */
+      bool load(const std::string& fileName) {
+          std::ifstream in(fileName.c_str());
+          double step;
+          size_t count;
+          if (!(in >> step >> count) || step <= 0) {
+              ROS_ERROR("Invalid gaussian offset table %s", fileName.c_str());
+              return false;
+          }
+
+          std::vector<double> table(count);
+          for (size_t i = 0; i < count; ++i) {
+              if (!(in >> table[i])) {
+                  ROS_ERROR("Gaussian offset table %s is truncated at entry %lu", fileName.c_str(), i);
+                  return false;
+              }
+          }
+          tableStep = step;
+          offsets.swap(table);
+          return true;
+      }
+
+      /**
+       * Write the table as the step and count followed by one offset per line.
+       * @return False if there is no table or the file could not be written.
+       */
+      bool save(const std::string& fileName) const {
+          if (!hasTable()) {
+              return false;
+          }
+          std::ofstream out(fileName.c_str());
+          out.precision(std::numeric_limits<double>::digits10 + 2);
+          out << tableStep << " " << offsets.size() << std::endl;
+          for (size_t i = 0; i < offsets.size(); ++i) {
+              out << offsets[i] << std::endl;
+          }
+          if (!out) {
+              ROS_ERROR("Failed to write gaussian offset table %s", fileName.c_str());
+              return false;
+          }
+          return true;
+      }
+
+      /**
+       * Offset at time t from every gaussian that has started, without the active
+       * window. The reference the window is checked against.
+       */
+      double evaluateAllGaussians(const double t) const {
+          double offset = 0;
+          for (unsigned int j = 0; j < gaussParams.size() && gaussParams[j].startTime <= t; ++j) {
+              const GaussParams& params = gaussParams[j];
+
+              double gx = t - params.startTime - GAUSS_HALF_WIDTH * params.c;
+              offset += params.a * exp(-(utils::square(gx) / (2 * utils::square(params.c))));
+          }
+          return offset;
+      }
+
+    private:
+      struct GaussParams {
+          double a;
+          double c;
+          double startTime;
+
+          //! Time after which the gaussian no longer contributes.
+          double endTime;
+      };
+
+      void resetWindow() {
+          activeGauss.clear();
+          nextGauss = 0;
+          activeGaussTime = 0.0;
+      }
+
+      /**
+       * Linearly interpolate the table. Times past the end hold the last offset.
+       */
+      double lookupOffset(const double t) const {
+          if (t <= 0) {
+              return offsets.front();
+          }
+          const double position = t / tableStep;
+          const size_t i = static_cast<size_t>(position);
+          if (i + 1 >= offsets.size()) {
+              return offsets.back();
+          }
+          const double fraction = position - i;
+          return offsets[i] + fraction * (offsets[i + 1] - offsets[i]);
+      }
+
+      double evaluateOffset(const double t) {
+          advanceActiveGaussians(t);
+
+          // Iterate over the gaussians that still contribute.
+          double offset = 0;
+          for (unsigned int j = 0; j < activeGauss.size(); ++j) {
+              const GaussParams& params = gaussParams[activeGauss[j]];
+
+              double gx = t - params.startTime - GAUSS_HALF_WIDTH * params.c;
+              offset += params.a * exp(-(utils::square(gx) / (2 * utils::square(params.c))));
+          }
+          return offset;
+      }
+
+      /**
+       * Move the active gaussians forward to time t. Gaussians are added as they start
+       * and dropped once they pass their end time, so each call only touches the
+       * gaussians that contribute.
+       */
+      void advanceActiveGaussians(const double t) {
+          // Time went backwards, e.g. the path was restarted. Rebuild from the beginning.
+          if (t < activeGaussTime) {
+              resetWindow();
+          }
+          activeGaussTime = t;
+
+          // Start times are strictly increasing.
+          for (; nextGauss < gaussParams.size() && gaussParams[nextGauss].startTime <= t; ++nextGauss) {
+              activeGauss.push_back(nextGauss);
+          }
+
+          // Keep the start order so the sum matches evaluating every gaussian.
+          unsigned int kept = 0;
+          for (unsigned int j = 0; j < activeGauss.size(); ++j) {
+              if (t <= gaussParams[activeGauss[j]].endTime) {
+                  activeGauss[kept++] = activeGauss[j];
+              }
+          }
+          activeGauss.resize(kept);
+      }
+
+      // Parameters for all operating gaussians
+      std::vector<GaussParams> gaussParams;
+
+      //! Index of the first gaussian that has not started yet.
+      unsigned int nextGauss;
+
+      //! Indices of the started gaussians that still contribute, in start order.
+      std::vector<unsigned int> activeGauss;
+
+      //! Time the active gaussians were last advanced to.
+      double activeGaussTime;
+
+      //! Precomputed offsets every tableStep seconds from time 0. Empty if not precomputed.
+      std::vector<double> offsets;
+      double tableStep;
+  };
+}
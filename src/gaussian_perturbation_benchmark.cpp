@@ -0,0 +1,97 @@
+#include <ros/ros.h>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+#include "path_provider_factory.h"
+#include "gaussian_perturbation.h"
+#include "arguments.h"
+
+/**
+ * Replays the gaussian perturbation of the dog model plugin at its update rate and
+ * times the active window against evaluating every started gaussian, and checks
+ * that both give the same offsets. The walk is repeated cycles times so the late
+ * part of a long walk, where most gaussians have ended, is covered.
+ *
+ * Parameters are passed as name:=value, e.g.
+ * gaussian_perturbation_benchmark path_type:=lissajous cycles:=20 gauss_seed:=5489
+ */
+namespace {
+using namespace std;
+
+//! Update period of the dog model plugin.
+const double UPDATE_PERIOD = 0.001;
+
+const int CYCLES_DEFAULT = 20;
+}
+
+int main(int argc, char** argv) {
+    ros::Time::init();
+
+    Arguments args;
+    if (!parseArguments(argc, argv, args)) {
+        return 1;
+    }
+
+    string pathType;
+    int cycles;
+    unsigned int seed;
+    GaussianParameters params;
+    try {
+        pathType = getArgument<string>(args, "path_type", "lissajous");
+        cycles = getArgument<int>(args, "cycles", CYCLES_DEFAULT);
+        seed = getArgument<unsigned int>(args, "gauss_seed", GAUSS_SEED_DEFAULT);
+        params.pNewGauss = getArgument<double>(args, "p_new_gauss", P_NEW_GAUSS_DEFAULT);
+    }
+    catch (const boost::bad_lexical_cast& e) {
+        ROS_ERROR("Invalid argument: %s", e.what());
+        return 1;
+    }
+    if (!checkArgumentsUsed(args)) {
+        return 1;
+    }
+    if (cycles <= 0) {
+        ROS_ERROR("cycles must be positive");
+        return 1;
+    }
+
+    auto_ptr<PathProvider> provider(createPathProvider(pathType));
+    if (!provider.get()) {
+        ROS_ERROR("Unknown path type %s", pathType.c_str());
+        return 1;
+    }
+    provider->init();
+    const double duration = cycles * provider->getMaximumTime().toSec();
+
+    boost::mt19937 rng(seed);
+    GaussianPerturbation perturbation;
+    perturbation.generate(rng, duration, params);
+
+    // The plugin perturbs with the whole seconds elapsed, at every update.
+    const size_t updates = static_cast<size_t>(duration / UPDATE_PERIOD);
+    vector<double> windowed(updates);
+    vector<double> full(updates);
+
+    ros::WallTime start = ros::WallTime::now();
+    for (size_t i = 0; i < updates; ++i) {
+        windowed[i] = perturbation.offsetAt(floor(i * UPDATE_PERIOD));
+    }
+    const double windowedTime = (ros::WallTime::now() - start).toSec();
+
+    start = ros::WallTime::now();
+    for (size_t i = 0; i < updates; ++i) {
+        full[i] = perturbation.evaluateAllGaussians(floor(i * UPDATE_PERIOD));
+    }
+    const double fullTime = (ros::WallTime::now() - start).toSec();
+
+    double offsetError = 0;
+    for (size_t i = 0; i < updates; ++i) {
+        offsetError = max(offsetError, fabs(windowed[i] - full[i]));
+    }
+
+    printf("path_type %s duration %f s gaussians %lu updates %lu full %f s windowed %f s speedup %f "
+            "offset_error %g\n", pathType.c_str(), duration, perturbation.getGaussianCount(), updates, fullTime,
+            windowedTime, windowedTime > 0 ? fullTime / windowedTime : 0.0, offsetError);
+    return 0;
+}
@@ -3,24 +3,334 @@
 #include <dogsim/StartPath.h>
 #include <dogsim/MaximumTime.h>
 #include <geometry_msgs/Point.h>
-#include "path_provider.h"
-#include "lissajous_path_provider.h"
-#include "rectangle_path_provider.h"
-#include "block_walk_path_provider.h"
-#include "random_walk_path_provider.h"
+#include "path_provider_factory.h"
+#include "path_client.h"
+#include "robot_path.h"
 #include <dogsim/GetEntirePath.h>
 #include <dogsim/GetEntireRobotPath.h>
+#include <dogsim/GetPathPage.h>
+#include <dogsim/PathChunk.h>
 #include <tf/transform_listener.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <map>
 
 namespace {
 using namespace ros;
 using namespace std;
 
-const double TRAILING_DISTANCE = 0;
+//! Default increment of the path published in chunks.
+const double CHUNK_INCREMENT_DEFAULT = 0.25;
 
-//! Shift distance from base to desired arm position
-//! Calculated as the negative of /base_footprint to /r_wrist_roll_link in x axis
-const double SHIFT_DISTANCE = 0.6;
+//! Default number of poses per published chunk.
+const int CHUNK_SIZE_DEFAULT = 200;
+
+//! Default number of threads serving requests.
+const int THREADS_DEFAULT = 4;
+
+//! Sampled path shared by the cache and the readers copying it out. Never modified once cached.
+typedef boost::shared_ptr<const vector<geometry_msgs::PoseStamped> > CachedPathConstPtr;
+
+//! Number of increments each path cache keeps. Clients use one or two increments, and
+//! any others are evicted least recently used first rather than kept until the next start.
+const size_t PATH_CACHE_SIZE = 4;
+
+/**
+ * Sampled path in the cache and when it was last used.
+ */
+struct CachedPath {
+    CachedPath() : lastUsed(0) {
+    }
+
+    CachedPathConstPtr poses;
+    unsigned long lastUsed;
+};
+
+//! Sampled paths keyed by their increment. At most PATH_CACHE_SIZE entries.
+typedef map<double, CachedPath> PathCache;
+
+/**
+ * Start state of a walk. Never modified once published so readers can use it
+ * without locking.
+ */
+struct WalkState {
+    WalkState(const bool _started, const ros::Time& _startTime, const unsigned int _version) :
+        started(_started), startTime(_startTime), version(_version) {
+    }
+
+    const bool started;
+    const ros::Time startTime;
+
+    //! Incremented whenever the start time changes and the cached paths become stale.
+    const unsigned int version;
+};
+typedef boost::shared_ptr<const WalkState> WalkStateConstPtr;
+
+/**
+ * A single walk with its own path and start time.
+ */
+class WalkSession {
+public:
+	typedef void (WalkSession::*PathBuilder)(const double increment, const ros::Time& pathStartTime,
+	        const size_t offset, const size_t count, vector<geometry_msgs::PoseStamped>& poses) const;
+
+private:
+	const string name;
+	auto_ptr<PathProvider> pathProvider;
+
+	//! Current start state. Swapped atomically so path queries never wait on a start.
+	WalkStateConstPtr state;
+
+	//! Publishers that stream the sampled paths in chunks.
+	ros::Publisher pathChunkPub;
+	ros::Publisher robotPathChunkPub;
+
+	//! Latched description of the walk so clients can evaluate it locally.
+	ros::Publisher pathDescriptionPub;
+
+	const double chunkIncrement;
+	const int chunkSize;
+
+	//! Guards the caches and serializes changes to the start state.
+	boost::mutex cacheMutex;
+
+	PathCache entirePathCache;
+	PathCache entireRobotPathCache;
+
+	//! Counts cache lookups to order the entries by use.
+	unsigned long cacheUses;
+
+public:
+	/**
+	 * @param _name Session name. Empty for the default walk.
+	 * @param provider Initialized path provider. The session takes ownership.
+	 */
+	WalkSession(NodeHandle& nh, const string& _name, PathProvider* provider, const double _chunkIncrement,
+	        const int _chunkSize) :
+	    name(_name), pathProvider(provider), state(new WalkState(false, ros::Time(), 0)),
+	    chunkIncrement(_chunkIncrement), chunkSize(_chunkSize), cacheUses(0) {
+
+		// Share the path so clients can evaluate it locally.
+		pathDescriptionPub = nh.advertise<dogsim::PathDescription>(
+		        getSessionTopic(name, PATH_DESCRIPTION_TOPIC), 1, true);
+		publishDescription();
+
+		// Stream the whole path in chunks to each new subscriber, and again to everyone
+		// once the path starts.
+		const unsigned int chunkQueueSize = getSampleCount(chunkIncrement) / chunkSize + 1;
+		pathChunkPub = nh.advertise<dogsim::PathChunk>(getSessionTopic(name, "/dogsim/path_chunks"),
+		        chunkQueueSize,
+		        boost::bind(&WalkSession::publishChunks<ros::SingleSubscriberPublisher>, this, _1,
+		                &WalkSession::buildEntirePath));
+		robotPathChunkPub = nh.advertise<dogsim::PathChunk>(getSessionTopic(name, "/dogsim/robot_path_chunks"),
+		        chunkQueueSize,
+		        boost::bind(&WalkSession::publishChunks<ros::SingleSubscriberPublisher>, this, _1,
+		                &WalkSession::buildEntireRobotPath));
+	}
+
+	/**
+	 * Start the walk at the given time. Starting again restarts the walk.
+	 */
+	void start(const ros::Time& time) {
+		{
+		    boost::mutex::scoped_lock lock(cacheMutex);
+		    const WalkStateConstPtr previous = getState();
+		    if (previous->started) {
+		        ROS_INFO("Restarting %s walk", getDisplayName().c_str());
+		    }
+		    boost::atomic_store(&state, WalkStateConstPtr(new WalkState(true, time, previous->version + 1)));
+
+		    // Cached paths are stamped relative to the old start time.
+		    entirePathCache.clear();
+		    entireRobotPathCache.clear();
+		}
+		ROS_DEBUG("Starting %s walk @ time: %f", getDisplayName().c_str(), time.toSec());
+		publishDescription();
+
+		// Restream the chunks with the new stamps.
+		publishChunks(pathChunkPub, &WalkSession::buildEntirePath);
+		publishChunks(robotPathChunkPub, &WalkSession::buildEntireRobotPath);
+	}
+
+	void getPath(const ros::Time& time, dogsim::GetPath::Response& res) const {
+	    const WalkStateConstPtr current = getState();
+	    ROS_DEBUG("Getting path position for time %f", current->startTime.toSec());
+		computePath(*pathProvider, current->started, current->startTime, time, res);
+		ROS_DEBUG("Elapsed time is %f", res.elapsedTime.toSec());
+	}
+
+	ros::Duration getMaximumTime() const {
+	    return pathProvider->getMaximumTime();
+	}
+
+	void getPathPage(PathBuilder build, const dogsim::GetPathPage::Request& req,
+	        dogsim::GetPathPage::Response& res) const {
+	    ROS_DEBUG("Getting path page at offset %u with %u poses and increment %f", req.offset,
+	            req.count, req.increment);
+	    res.startTime = getState()->startTime;
+	    const size_t total = getSampleCount(req.increment);
+	    res.total = total;
+
+	    const size_t offset = min<size_t>(req.offset, total);
+	    (this->*build)(req.increment, res.startTime, offset, min<size_t>(req.count, total - offset), res.poses);
+	}
+
+	void getEntirePath(const double increment, vector<geometry_msgs::PoseStamped>& poses) {
+		ROS_DEBUG("Getting entire path for max time %f and increment %f",
+		        pathProvider->getMaximumTime().toSec(), increment);
+		getCachedPath(entirePathCache, &WalkSession::buildEntirePath, increment, poses);
+	}
+
+	void getEntireRobotPath(const double increment, vector<geometry_msgs::PoseStamped>& poses) {
+		ROS_DEBUG("Getting entire robot path for max time %f and increment %f",
+		        pathProvider->getMaximumTime().toSec(), increment);
+		getCachedPath(entireRobotPathCache, &WalkSession::buildEntireRobotPath, increment, poses);
+	}
+
+	/**
+	 * Build count dog poses starting at sample offset.
+	 */
+	void buildEntirePath(const double increment, const ros::Time& pathStartTime,
+	        const size_t offset, const size_t count, vector<geometry_msgs::PoseStamped>& poses) const {
+		PathSamples samples;
+		pathProvider->samplePoses(offset * increment, increment, count, samples);
+
+		poses.resize(samples.size());
+		for (size_t i = 0; i < samples.size(); ++i) {
+		    geometry_msgs::PoseStamped& pose = poses[i];
+		    pose.header.frame_id = "/map";
+		    // Set the time to the moment of the goal
+		    pose.header.stamp = pathStartTime + ros::Duration((offset + i) * increment);
+		    pose.pose.position.x = samples.x[i];
+		    pose.pose.position.y = samples.y[i];
+		    pose.pose.orientation = tf::createQuaternionMsgFromYaw(samples.yaw[i]);
+		}
+	}
+
+    /**
+     * Build count robot poses starting at sample offset.
+     */
+    void buildEntireRobotPath(const double increment, const ros::Time& pathStartTime,
+            const size_t offset, const size_t count, vector<geometry_msgs::PoseStamped>& poses) const {
+        PathSamples samples;
+        pathProvider->samplePoses(offset * increment, increment, count, samples);
+
+        poses.resize(samples.size());
+        for (size_t i = 0; i < samples.size(); ++i) {
+            poses[i] = getPlannedRobotPose(samples.x[i], samples.y[i], samples.yaw[i]);
+            // Set the time to the moment of the goal
+            poses[i].header.stamp = pathStartTime + ros::Duration((offset + i) * increment);
+        }
+    }
+
+private:
+    WalkStateConstPtr getState() const {
+        return boost::atomic_load(&state);
+    }
+
+    string getDisplayName() const {
+        return name.empty() ? "default" : name;
+    }
+
+	/**
+	 * Publish the path at the chunk increment in chunks of chunkSize poses.
+	 * @param pub Publisher to send to. Either a single new subscriber or all subscribers.
+	 */
+	template<class Publisher>
+	void publishChunks(const Publisher& pub, PathBuilder build) {
+	    const ros::Time pathStartTime = getState()->startTime;
+
+	    const size_t total = getSampleCount(chunkIncrement);
+	    for (size_t offset = 0; offset < total; offset += chunkSize) {
+	        dogsim::PathChunk chunk;
+	        chunk.header.stamp = pathStartTime;
+	        chunk.header.frame_id = "/map";
+	        chunk.increment = chunkIncrement;
+	        chunk.offset = offset;
+	        chunk.total = total;
+	        (this->*build)(chunkIncrement, pathStartTime, offset, min<size_t>(chunkSize, total - offset),
+	                chunk.poses);
+	        pub.publish(chunk);
+	    }
+	}
+
+    /**
+     * Copy the path for the increment out of the cache, building and caching it on a miss.
+     * Only the pointer is taken under the lock, so readers copy the poses concurrently.
+     * A hit saves evaluating the path but still copies every pose into the response,
+     * which is linear in the length of the path.
+     */
+    void getCachedPath(PathCache& cache, PathBuilder build, const double increment,
+            vector<geometry_msgs::PoseStamped>& poses) {
+        const WalkStateConstPtr current = getState();
+        CachedPathConstPtr cached;
+        {
+            boost::mutex::scoped_lock lock(cacheMutex);
+            PathCache::iterator i = cache.find(increment);
+            if (i != cache.end()) {
+                i->second.lastUsed = ++cacheUses;
+                cached = i->second.poses;
+            }
+        }
+        if (cached) {
+            ROS_DEBUG("Returning cached path for increment %f", increment);
+            poses = *cached;
+            return;
+        }
+
+        boost::shared_ptr<vector<geometry_msgs::PoseStamped> > built(new vector<geometry_msgs::PoseStamped>());
+        (this->*build)(increment, current->startTime, 0, getSampleCount(increment), *built);
+        poses = *built;
+
+        boost::mutex::scoped_lock lock(cacheMutex);
+        // Do not cache a path that was stamped with a start time that has since changed.
+        if (getState()->version == current->version) {
+            if (cache.size() >= PATH_CACHE_SIZE && cache.find(increment) == cache.end()) {
+                evictLeastRecentlyUsed(cache);
+            }
+            CachedPath& entry = cache[increment];
+            entry.poses = built;
+            entry.lastUsed = ++cacheUses;
+        }
+    }
+
+    /**
+     * Remove the entry used longest ago. Must be called with the cache mutex held.
+     */
+    static void evictLeastRecentlyUsed(PathCache& cache) {
+        PathCache::iterator oldest = cache.begin();
+        for (PathCache::iterator i = cache.begin(); i != cache.end(); ++i) {
+            if (i->second.lastUsed < oldest->second.lastUsed) {
+                oldest = i;
+            }
+        }
+        if (oldest != cache.end()) {
+            ROS_DEBUG("Evicting cached path for increment %f", oldest->first);
+            cache.erase(oldest);
+        }
+    }
+
+    /**
+     * Number of samples from the start to the maximum time.
+     */
+    size_t getSampleCount(const double increment) const {
+        return increment > 0 ?
+                static_cast<size_t>(ceil(pathProvider->getMaximumTime().toSec() / increment)) : 0;
+    }
+
+	void publishDescription() {
+	    dogsim::PathDescription description;
+	    pathProvider->describe(description);
+	    description.header.stamp = ros::Time::now();
+	    description.session = name;
+	    description.maximumTime = pathProvider->getMaximumTime();
+
+	    const WalkStateConstPtr current = getState();
+	    description.started = current->started;
+	    description.startTime = current->startTime;
+	    pathDescriptionPub.publish(description);
+	}
+};
 
 class GetPathServer {
 
@@ -32,15 +342,43 @@ private:
 	ros::ServiceServer maxService;
 	ros::ServiceServer entirePathService;
 	ros::ServiceServer entireRobotPathService;
+	ros::ServiceServer pathPageService;
+	ros::ServiceServer robotPathPageService;
 
-	bool started;
-	ros::Time startTime;
-	auto_ptr<PathProvider> pathProvider;
+	//! Walk sessions keyed by name. Only modified during construction so lookups need no lock.
+	typedef map<string, boost::shared_ptr<WalkSession> > SessionMap;
+	SessionMap sessions;
 
 public:
 
 	GetPathServer() :
-		pnh("~"), started(false) {
+		pnh("~") {
+		double chunkIncrement;
+		int chunkSize;
+		pnh.param<double>("chunk_increment", chunkIncrement, CHUNK_INCREMENT_DEFAULT);
+		pnh.param<int>("chunk_size", chunkSize, CHUNK_SIZE_DEFAULT);
+		chunkSize = max(chunkSize, 1);
+
+		// The default session always exists. Additional sessions are listed in ~sessions
+		// and may override the path type with ~<session>/path_type.
+		string defaultPathType;
+		pnh.param<string>("path_type", defaultPathType, "lissajous");
+		addSession("", defaultPathType, chunkIncrement, chunkSize);
+
+		XmlRpc::XmlRpcValue sessionNames;
+		if (pnh.getParam("sessions", sessionNames)) {
+		    if (sessionNames.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+		        ROS_ERROR("Parameter sessions must be a list of session names");
+		    } else {
+		        for (int i = 0; i < sessionNames.size(); ++i) {
+		            const string name = static_cast<string>(sessionNames[i]);
+		            string pathType;
+		            pnh.param<string>(name + "/path_type", pathType, defaultPathType);
+		            addSession(name, pathType, chunkIncrement, chunkSize);
+		        }
+		    }
+		}
+
 		service = nh.advertiseService("/dogsim/get_path",
 				&GetPathServer::getPath, this);
 		entirePathService = nh.advertiseService("/dogsim/get_entire_path",
@@ -53,135 +391,106 @@ public:
 		maxService = nh.advertiseService("/dogsim/maximum_time",
 				&GetPathServer::maximumTime, this);
 
-		string pathType;
-		pnh.param<string>("path_type", pathType, "lissajous");
-		if (pathType == "lissajous") {
-			pathProvider.reset(new LissajousPathProvider());
-		} else if (pathType == "rectangle") {
-			pathProvider.reset(new RectanglePathProvider());
-		} else if (pathType == "blockwalk") {
-			pathProvider.reset(new BlockWalkPathProvider());
-		} else if (pathType == "randomwalk") {
-            pathProvider.reset(new RandomWalkPathProvider());
-		} else {
+		// Paged access so clients only transfer the window they need.
+		pathPageService = nh.advertiseService<dogsim::GetPathPage::Request, dogsim::GetPathPage::Response>(
+		        "/dogsim/get_path_page",
+		        boost::bind(&GetPathServer::getPathPage, this, &WalkSession::buildEntirePath, _1, _2));
+		robotPathPageService = nh.advertiseService<dogsim::GetPathPage::Request, dogsim::GetPathPage::Response>(
+		        "/dogsim/get_robot_path_page",
+		        boost::bind(&GetPathServer::getPathPage, this, &WalkSession::buildEntireRobotPath, _1, _2));
+	}
+
+private:
+	void addSession(const string& name, const string& pathType, const double chunkIncrement,
+	        const int chunkSize) {
+		if (sessions.count(name)) {
+		    ROS_ERROR("Duplicate walk session: %s", name.c_str());
+		    return;
+		}
+
+		PathProvider* pathProvider = createPathProvider(pathType);
+		if (!pathProvider) {
 			ROS_ERROR("Unknown path provider type: %s", pathType.c_str());
 			return;
 		}
-		ROS_INFO("%s path type selected", pathType.c_str());
+		ROS_INFO("%s path type selected for %s walk", pathType.c_str(),
+		        name.empty() ? "default" : name.c_str());
 		pathProvider->init();
+		sessions[name].reset(new WalkSession(nh, name, pathProvider, chunkIncrement, chunkSize));
+	}
+
+	/**
+	 * Find the session for a request.
+	 * @return The session, or NULL if it does not exist.
+	 */
+	WalkSession* findSession(const string& name) const {
+	    SessionMap::const_iterator session = sessions.find(name);
+	    if (session == sessions.end()) {
+	        ROS_ERROR("Unknown walk session: %s", name.c_str());
+	        return NULL;
+	    }
+	    return session->second.get();
 	}
 
-private:
 	bool start(dogsim::StartPath::Request& req,
 			dogsim::StartPath::Response& res) {
-		assert(!started);
-		started = true;
-		startTime = req.time;
-		ROS_DEBUG("Starting path @ time: %f", startTime.toSec());
+		WalkSession* session = findSession(req.session);
+		if (!session) {
+		    return false;
+		}
+		session->start(req.time);
+		return true;
+	}
+
+	bool getPathPage(WalkSession::PathBuilder build, dogsim::GetPathPage::Request& req,
+	        dogsim::GetPathPage::Response& res) {
+		const WalkSession* session = findSession(req.session);
+		if (!session) {
+		    return false;
+		}
+		session->getPathPage(build, req, res);
 		return true;
 	}
 
 	bool maximumTime(dogsim::MaximumTime::Request& req,
 			dogsim::MaximumTime::Response& res) {
-		res.maximumTime = pathProvider->getMaximumTime();
+		const WalkSession* session = findSession(req.session);
+		if (!session) {
+		    return false;
+		}
+		res.maximumTime = session->getMaximumTime();
 		ROS_DEBUG("Returning maximum time: %f", res.maximumTime.toSec());
 		return true;
 	}
 
 	bool getEntirePath(dogsim::GetEntirePath::Request& req,
 			dogsim::GetEntirePath::Response& res) {
-		ROS_DEBUG(
-				"Getting entire path for max time %f and increment %f", pathProvider->getMaximumTime().toSec(), req.increment);
-		for (double t = 0; t < pathProvider->getMaximumTime().toSec();
-				t += req.increment) {
-		    geometry_msgs::PoseStamped pose = pathProvider->poseAtTime(ros::Duration(t));
-		    // Set the time to the moment of the goal
-		    pose.header.stamp = startTime + ros::Duration(t);
-			res.poses.push_back(pose);
+		WalkSession* session = findSession(req.session);
+		if (!session) {
+		    return false;
 		}
+		session->getEntirePath(req.increment, res.poses);
 		return true;
 	}
 
     bool getEntireRobotPath(dogsim::GetEntireRobotPath::Request& req,
             dogsim::GetEntireRobotPath::Response& res) {
-        ROS_DEBUG(
-                "Getting entire robot path for max time %f and increment %f", pathProvider->getMaximumTime().toSec(), req.increment);
-        for (double t = 0; t < pathProvider->getMaximumTime().toSec();
-                t += req.increment) {
-            geometry_msgs::PoseStamped pose = getPlannedRobotPose(ros::Duration(t));
-            // Set the time to the moment of the goal
-            pose.header.stamp = startTime + ros::Duration(t);
-            res.poses.push_back(pose);
+        WalkSession* session = findSession(req.session);
+        if (!session) {
+            return false;
         }
+        session->getEntireRobotPath(req.increment, res.poses);
         return true;
     }
 
-	geometry_msgs::PoseStamped getPlannedRobotPose(ros::Duration t) {
-
-	    const geometry_msgs::PoseStamped dogGoal = pathProvider->poseAtTime(t);
-
-	    const geometry_msgs::PoseStamped goal2 = pathProvider->poseAtTime(t + SLOPE_DELTA);
-
-	    // Calculate the vector of the tangent line.
-	    btVector3 tangent = btVector3(goal2.pose.position.x, goal2.pose.position.y, 0)
-	    - btVector3(dogGoal.pose.position.x, dogGoal.pose.position.y, 0);
-	    tangent.normalize();
-
-	    // Now select a point on the vector but slightly behind.
-	    btVector3 backGoal = btVector3(dogGoal.pose.position.x, dogGoal.pose.position.y, 0)
-	    - tangent * tfScalar(TRAILING_DISTANCE);
-
-	    // Rotate the vector to perpendicular
-	    btVector3 perp = tangent.rotate(btVector3(0, 0, 1),
-	            tfScalar(boost::math::constants::pi<double>() / 2.0));
-
-	    // Select a point on the perpendicular line.
-	    btVector3 finalGoal = backGoal + perp * tfScalar(SHIFT_DISTANCE);
-
-	    geometry_msgs::PoseStamped robotGoal;
-	    robotGoal.pose.position.x = finalGoal.x();
-	    robotGoal.pose.position.y = finalGoal.y();
-	    robotGoal.pose.position.z = finalGoal.z();
-	    robotGoal.header = dogGoal.header;
-
-	    // Calculate the yaw so we can create an orientation.
-	    tfScalar yaw = tfAtan2(tangent.y(), tangent.x());
-	    robotGoal.pose.orientation = tf::createQuaternionMsgFromYaw(yaw);
-
-	    return robotGoal;
-	}
-
 	bool getPath(dogsim::GetPath::Request& req,
 			dogsim::GetPath::Response& res) {
-
-	    ROS_DEBUG("Getting path position for time %f", startTime.toSec());
-		res.elapsedTime = req.time - startTime;
-		ROS_DEBUG("Elapsed time is %f", res.elapsedTime.toSec());
-
-		computeStartAndEnd(ros::Time(req.time), res.started, res.ended);
-
-		// Allow calling get path prior to starting and return the begin position.
-		geometry_msgs::PoseStamped result = pathProvider->poseAtTime(res.started ? (req.time - startTime): ros::Duration(0));
-		res.point.header = result.header;
-		res.point.point = result.pose.position;
-		assert(res.point.header.frame_id.size() > 0);
-		return true;
-	}
-
-	void computeStartAndEnd(const ros::Time& time, uint8_t& rStarted,
-			uint8_t& rEnded) const {
-		if (!this->started) {
-		    ROS_DEBUG("Path not started yet");
-			// Not started yet.
-			rEnded = false;
-			rStarted = false;
-		} else if ((time - startTime) > pathProvider->getMaximumTime()) {
-			rEnded = true;
-			rStarted = true;
-		} else {
-			rStarted = true;
-			rEnded = false;
+		const WalkSession* session = findSession(req.session);
+		if (!session) {
+		    return false;
 		}
+		session->getPath(req.time, res);
+		return true;
 	}
 };
 }
@@ -189,8 +498,10 @@ private:
 int main(int argc, char** argv) {
 	ros::init(argc, argv, "get_path");
 	GetPathServer getPathServer;
-	ros::MultiThreadedSpinner spinner(4);
+
+	int threads;
+	ros::NodeHandle("~").param<int>("threads", threads, THREADS_DEFAULT);
+	ros::MultiThreadedSpinner spinner(max(threads, 1));
 	spinner.spin();
 	return 0;
 }
-
@@ -8,6 +8,14 @@
 #include <stdlib.h>
 #include <time.h>
 #include <dogsim/LeashInfo.h>
+#include <dogsim/LeashInfoArray.h>
+#include <boost/thread/thread.hpp>
+#include <visualization_msgs/Marker.h>
+#include <dogsim/utils.h>
+#include "tick_profiler.h"
+#include "segmented_leash.h"
+#include "single_producer_ring.h"
+#include "leash_spring.h"
 
 
 
@@ -15,21 +23,55 @@ namespace {
 using namespace std;
 using namespace gazebo;
 
-// Amount of force the leash can apply at its maximum
-const double SPRING_FORCE = 60.0;
+// Defaults for the segmented leash. The compliance gives the full spring force at
+// about the stretch where the sigmoid spring saturates.
+const int LEASH_ITERATIONS_DEFAULT = 10;
+const double LEASH_COMPLIANCE_DEFAULT = 1.5e-3;
+const double LEASH_DAMPING_DEFAULT = 0.5;
+const double LEASH_MASS_DEFAULT = 0.2;
 
-// Rate to run the updates to the force
-const double UPDATE_RATE = 0.01;
+// Bodies the segmented leash wraps around. The PR2 base is 0.668 m square, so its
+// cylinder is the circle around that square, up to the top of the base. The dog's
+// cylinder is as wide and as tall as its body box.
+const double LEASH_BASE_RADIUS = sqrt(2 * utils::square(0.668 / 2.0));
+const double LEASH_BASE_TOP = 0.3;
+const double LEASH_DOG_RADIUS = 0.05;
+
+// Default rate in Hz to publish batches of leash samples at.
+const double LEASH_INFO_BATCH_RATE_DEFAULT = 5.0;
+
+// Number of samples buffered between batches. 40 s at the update rate.
+const size_t LEASH_INFO_RING_CAPACITY = 4096;
+
+/**
+ * Leash state recorded on the physics thread. Converted to a LeashInfo when published.
+ */
+struct LeashSample {
+    double stamp;
+    double forceX;
+    double forceY;
+    double forceZ;
+    double distance;
+    double ratio;
+};
 
 class LeashModelPlugin : public ModelPlugin {
 public:
-    LeashModelPlugin() {
+    LeashModelPlugin() : leashInfoRing(LEASH_INFO_RING_CAPACITY), droppedSamples(0),
+        profiler("leash_model_plugin") {
         ROS_INFO("Creating Leash Model Plugin");
-        leashInfoPub = nh.advertise<dogsim::LeashInfo>("leash_model/info", 1);
+        leashInfoPub = nh.advertise<dogsim::LeashInfoArray>("leash_model/info_array", 10);
+        lookupStage = profiler.addStage("lookup");
+        springStage = profiler.addStage("spring");
+        segmentStage = profiler.addStage("segments");
+        publishStage = profiler.addStage("publish");
+        forceStage = profiler.addStage("force");
     }
 
     ~LeashModelPlugin() {
         ROS_INFO("Destroying Leash Model Plugin");
+        publishThread.interrupt();
+        publishThread.join();
     }
 
     void Load(physics::ModelPtr _leash, sdf::ElementPtr /*_sdf*/) {
@@ -39,6 +81,28 @@ public:
         this->world = _leash->GetWorld();
 
         nh.param("leash_length", leashLength, 1.5);
+        profiler.start(nh);
+
+        // Serialize and publish the samples in batches off the physics thread.
+        double batchRate;
+        nh.param("leash_info_batch_rate", batchRate, LEASH_INFO_BATCH_RATE_DEFAULT);
+        publishThread = boost::thread(&LeashModelPlugin::publishLoop, this, max(batchRate, 0.1));
+
+        // Optionally model the leash as a chain of point masses instead of a single spring.
+        int segments;
+        nh.param("leash_segments", segments, 0);
+        if (segments > 0) {
+            int iterations;
+            double compliance, damping, mass;
+            nh.param("leash_iterations", iterations, LEASH_ITERATIONS_DEFAULT);
+            nh.param("leash_compliance", compliance, LEASH_COMPLIANCE_DEFAULT);
+            nh.param("leash_damping", damping, LEASH_DAMPING_DEFAULT);
+            nh.param("leash_mass", mass, LEASH_MASS_DEFAULT);
+            segmentedLeash.reset(new SegmentedLeash(segments, leashLength, max(iterations, 1), compliance,
+                    damping, mass));
+            segmentsPub = nh.advertise<visualization_msgs::Marker>("leash_model/segments", 1);
+            ROS_INFO("Using a segmented leash with %u segments", segmentedLeash->getSegmentCount());
+        }
 
         // Listen to the update event. This event is broadcast every
         // simulation iteration.
@@ -50,7 +114,10 @@ public:
 private:
     // Called by the world update start event
     void OnUpdate() {
+        StageTimer tickTimer(profiler, TICK_STAGE);
+
         // Find the robot
+        StageTimer lookupTimer(profiler, lookupStage);
         if(!robotHand){
             // Find the robots hand
             const physics::ModelPtr robot = this->world->GetModel("pr2");
@@ -63,6 +130,12 @@ private:
                 ROS_ERROR("Failed to locate r_wrist_roll_link");
                 return;
             }
+            robotBase = robot->GetLink("base_footprint");
+            if(!robotBase){
+                ROS_ERROR("Failed to locate base_footprint");
+                robotHand.reset();
+                return;
+            }
         }
 
         if(!dogBody){
@@ -79,50 +152,168 @@ private:
                 return;
             }
         }
+        lookupTimer.stop();
 
         common::Time currTime = this->world->GetSimTime();
-        if (currTime.Double() - this->previousTime.Double() > UPDATE_RATE) {
+        if (currTime.Double() - this->previousTime.Double() > LEASH_UPDATE_RATE) {
             // Calculate the distance between the two.
             const math::Vector3 handPosition = robotHand->GetWorldPose().pos;
             const math::Vector3 dogPosition = dogBody->GetWorldPose().pos;
             const double distance = handPosition.Distance(dogPosition);
 
-            // Now determine the ratio of force to apply using a sigmeud smoothing
-            // function.
-            // Octave function:
-            // x = [0:0.01:2.5];
-            // y = 1 ./ (1 + e.^(-48*(x - 1.25)));
-            const double ratio = 1.0 / (1.0 + exp(-48.0 * (abs(distance) - leashLength)));
-
-            // The hand force is a spring like attractive force between the hand and
-            // the dog.
-            const math::Vector3 handForce = (handPosition - dogPosition).Normalize();
-
-            // Reduce the force.
-            appliedForce = SPRING_FORCE * handForce * ratio;
-
-            ROS_DEBUG("Applying force x: %f y: %f z: %f with ratio: %f at distance: %f", appliedForce.x, appliedForce.y, appliedForce.z, ratio, distance);
+            double ratio;
+            if (segmentedLeash.get()) {
+                StageTimer segmentTimer(profiler, segmentStage);
+                ratio = updateSegmentedLeash((currTime - this->previousTime).Double(), handPosition, dogPosition);
+            } else {
+                StageTimer springTimer(profiler, springStage);
+                ratio = updateSpring(handPosition, dogPosition, distance);
+            }
 
+            StageTimer publishTimer(profiler, publishStage);
             if(leashInfoPub.getNumSubscribers() > 0){
-                dogsim::LeashInfo info;
-                info.header.stamp = ros::Time(currTime.Double());
-                info.header.frame_id = "/map";
-                info.force.x = appliedForce.x;
-                info.force.y = appliedForce.y;
-                info.force.z = appliedForce.z;
-                info.distance = distance;
-                info.ratio = ratio;
-                leashInfoPub.publish(info);
+                LeashSample sample;
+                sample.stamp = currTime.Double();
+                sample.forceX = appliedForce.x;
+                sample.forceY = appliedForce.y;
+                sample.forceZ = appliedForce.z;
+                sample.distance = distance;
+                sample.ratio = ratio;
+                if (!leashInfoRing.push(sample)) {
+                    ++droppedSamples;
+                }
+            }
+            if (segmentedLeash.get() && segmentsPub.getNumSubscribers() > 0) {
+                publishSegments(currTime);
             }
             this->previousTime = currTime;
         }
         // Apply the force to the dog.
+        StageTimer forceTimer(profiler, forceStage);
         dogBody->AddForce(appliedForce);
 
         // Don't allow the extra spring force to be applied to the arm.
         // Apply the opposite force to the hand.
-        robotHand->AddForce(math::Vector3(-appliedForce.x, -appliedForce.y, -appliedForce.z));
+        robotHand->AddForce(handForce);
+
+    }
+
+    /**
+     * Sigmoid spring between the hand and the dog.
+     * @return Ratio of the maximum spring force applied.
+     */
+    double updateSpring(const math::Vector3& handPosition, const math::Vector3& dogPosition,
+            const double distance) {
+        // Now determine the ratio of force to apply using a sigmeud smoothing
+        // function.
+        const double ratio = calcSpringRatio(distance, leashLength);
 
+        // The hand force is a spring like attractive force between the hand and
+        // the dog.
+        const math::Vector3 handDirection = (handPosition - dogPosition).Normalize();
+
+        // Reduce the force.
+        appliedForce = SPRING_FORCE * handDirection * ratio;
+
+        ROS_DEBUG("Applying force x: %f y: %f z: %f with ratio: %f at distance: %f", appliedForce.x, appliedForce.y, appliedForce.z, ratio, distance);
+
+        handForce = math::Vector3(-appliedForce.x, -appliedForce.y, -appliedForce.z);
+        return ratio;
+    }
+
+    /**
+     * Step the segmented leash and take the forces from the tension at each end.
+     * @return Ratio of the maximum spring force applied to the dog.
+     */
+    double updateSegmentedLeash(const double dt, const math::Vector3& handPosition,
+            const math::Vector3& dogPosition) {
+        // Wrap around where the bodies are now. The arm is not modelled.
+        const math::Vector3 basePosition = robotBase->GetWorldPose().pos;
+        segmentedLeash->clearObstacles();
+        segmentedLeash->addObstacle(LeashObstacle(basePosition.x, basePosition.y, 0.0, LEASH_BASE_TOP,
+                LEASH_BASE_RADIUS));
+        segmentedLeash->addObstacle(LeashObstacle(dogPosition.x, dogPosition.y, dogPosition.z - LEASH_DOG_RADIUS,
+                dogPosition.z + LEASH_DOG_RADIUS, LEASH_DOG_RADIUS));
+
+        segmentedLeash->step(dt, handPosition.x, handPosition.y, handPosition.z, dogPosition.x,
+                dogPosition.y, dogPosition.z);
+
+        // Pull each end towards its neighbouring point, limited to the spring force.
+        const unsigned int last = segmentedLeash->getSegmentCount();
+        const double dogTension = min(segmentedLeash->getTension(last - 1), SPRING_FORCE);
+        const double handTension = min(segmentedLeash->getTension(0), SPRING_FORCE);
+
+        double dx, dy, dz;
+        segmentedLeash->getDirection(last, last - 1, dx, dy, dz);
+        appliedForce = math::Vector3(dx, dy, dz) * dogTension;
+        segmentedLeash->getDirection(0, 1, dx, dy, dz);
+        handForce = math::Vector3(dx, dy, dz) * handTension;
+
+        ROS_DEBUG("Segmented leash tension at dog: %f at hand: %f", dogTension, handTension);
+        return dogTension / SPRING_FORCE;
+    }
+
+    /**
+     * Publish the buffered samples as a batch at the given rate until interrupted.
+     */
+    void publishLoop(const double rate) {
+        const boost::posix_time::milliseconds period(static_cast<long>(1000.0 / rate));
+        try {
+            while (ros::ok()) {
+                boost::this_thread::sleep(period);
+                publishSamples();
+            }
+        } catch (const boost::thread_interrupted&) {
+            // Send whatever was recorded since the last batch.
+            publishSamples();
+        }
+    }
+
+    void publishSamples() {
+        samples.clear();
+        if (leashInfoRing.drain(samples) == 0) {
+            return;
+        }
+        if (droppedSamples > 0) {
+            ROS_WARN("Dropped %u leash samples. Increase leash_info_batch_rate", droppedSamples);
+            droppedSamples = 0;
+        }
+
+        dogsim::LeashInfoArrayPtr batch(new dogsim::LeashInfoArray());
+        batch->header.stamp = ros::Time(samples.back().stamp);
+        batch->header.frame_id = "/map";
+        batch->samples.resize(samples.size());
+        for (size_t i = 0; i < samples.size(); ++i) {
+            dogsim::LeashInfo& info = batch->samples[i];
+            info.header.stamp = ros::Time(samples[i].stamp);
+            info.header.frame_id = "/map";
+            info.force.x = samples[i].forceX;
+            info.force.y = samples[i].forceY;
+            info.force.z = samples[i].forceZ;
+            info.distance = samples[i].distance;
+            info.ratio = samples[i].ratio;
+        }
+        leashInfoPub.publish(batch);
+    }
+
+    void publishSegments(const common::Time& currTime) {
+        visualization_msgs::Marker points;
+        points.header.stamp = ros::Time(currTime.Double());
+        points.header.frame_id = "/map";
+        points.ns = "dogsim";
+        points.id = 0;
+        points.type = visualization_msgs::Marker::LINE_STRIP;
+        points.action = visualization_msgs::Marker::ADD;
+        points.pose.orientation.w = 1.0;
+        points.color = utils::createColor(0.0, 1.0, 0.0);
+        points.scale.x = 0.02;
+        points.points.resize(segmentedLeash->getSegmentCount() + 1);
+        for (unsigned int i = 0; i < points.points.size(); ++i) {
+            points.points[i].x = segmentedLeash->getX(i);
+            points.points[i].y = segmentedLeash->getY(i);
+            points.points[i].z = segmentedLeash->getZ(i);
+        }
+        segmentsPub.publish(points);
     }
 
     // Previous update time
@@ -131,6 +322,9 @@ private:
     // Pointer to the hand
     physics::LinkPtr robotHand;
 
+    //! Robot base the segmented leash wraps around.
+    physics::LinkPtr robotBase;
+
     // Pointer to the dog
     physics::LinkPtr dogBody;
 
@@ -142,11 +336,36 @@ private:
 
     math::Vector3 appliedForce;
 
+    //! Force applied to the hand. Opposite to the dog's force for the spring.
+    math::Vector3 handForce;
+
+    //! Chain of point masses used instead of the spring when leash_segments is set.
+    auto_ptr<SegmentedLeash> segmentedLeash;
+    ros::Publisher segmentsPub;
+
     double leashLength;
 
     ros::NodeHandle nh;
 
     ros::Publisher leashInfoPub;
+
+    //! Samples recorded by the physics thread and published by publishThread.
+    SingleProducerRing<LeashSample> leashInfoRing;
+    boost::thread publishThread;
+
+    //! Publisher thread buffer for the drained samples.
+    vector<LeashSample> samples;
+
+    //! Samples dropped because the ring was full. Only an approximate count is needed.
+    volatile unsigned int droppedSamples;
+
+    //! Wall time spent in each update and its stages.
+    TickProfiler profiler;
+    unsigned int lookupStage;
+    unsigned int springStage;
+    unsigned int segmentStage;
+    unsigned int publishStage;
+    unsigned int forceStage;
 };
 
 // Register this plugin with the simulator
@@ -0,0 +1,24 @@
+#pragma once
+#include <cmath>
+
+namespace {
+
+  // Amount of force the leash can apply at its maximum
+  const double SPRING_FORCE = 60.0;
+
+  // Steepness of the sigmoid that ramps the force up as the leash becomes taut.
+  const double SPRING_STEEPNESS = 48.0;
+
+  // Rate to run the updates to the leash force
+  const double LEASH_UPDATE_RATE = 0.01;
+
+  /**
+   * Ratio of the maximum spring force applied with the hand and dog the given distance apart.
+   * Octave function:
+   * x = [0:0.01:2.5];
+   * y = 1 ./ (1 + e.^(-48*(x - 1.25)));
+   */
+  static double calcSpringRatio(const double distance, const double leashLength) {
+      return 1.0 / (1.0 + exp(-SPRING_STEEPNESS * (std::abs(distance) - leashLength)));
+  }
+}
@@ -1,6 +1,8 @@
+#pragma once
 #include <geometry_msgs/Point.h>
 #include "path_provider.h"
 #include <boost/math/constants/constants.hpp>
+#include <dogsim/PathDescription.h>
 
 namespace {
     
@@ -11,9 +13,30 @@ namespace {
   //! Amount of time it takes to perform a full lissajous cycle.
   const double FULL_CYCLE_T = 4.45;
 
+  //! Lissajous parameters. Defaults to the standard walk.
+  struct LissajousParameters {
+      double a;
+      double delta;
+      double A;
+      double B;
+      double b;
+      double timescaleFactor;
+      double fullCycleT;
+
+      LissajousParameters() :
+          a(sqrt(2)),
+          delta(boost::math::constants::pi<long double>() / 2.0),
+          A(6.0),
+          B(3.0),
+          b(2 * a),
+          timescaleFactor(TIMESCALE_FACTOR),
+          fullCycleT(FULL_CYCLE_T) {
+      }
+  };
+
   class LissajousPathProvider : public PathProvider {
       public:
-        LissajousPathProvider(){
+        LissajousPathProvider(const LissajousParameters& parameters = LissajousParameters()) : params(parameters) {
         }
         virtual ~LissajousPathProvider(){}
         
@@ -21,24 +44,62 @@ namespace {
         }
     
         virtual ros::Duration getMaximumTime() const {
-            return ros::Duration(FULL_CYCLE_T * TIMESCALE_FACTOR);
+            return ros::Duration(params.fullCycleT * params.timescaleFactor);
+        }
+
+        virtual void describe(dogsim::PathDescription& description) const {
+            description.pathType = "lissajous";
+            description.a = params.a;
+            description.b = params.b;
+            description.A = params.A;
+            description.B = params.B;
+            description.delta = params.delta;
+            description.timescaleFactor = params.timescaleFactor;
+            description.fullCycleT = params.fullCycleT;
         }
         
-      protected:
         virtual geometry_msgs::Point positionAtTime(const ros::Duration baseT) const {
-            // Lissajous parameters.
-            static const double a = sqrt(2);
-            static const double delta = boost::math::constants::pi<long double>() / 2.0;
-            static const double A = 6.0;
-            static const double B = 3.0;
-            static const double b = 2 * a;
-            double t = baseT.toSec() / TIMESCALE_FACTOR;
+            double t = baseT.toSec() / params.timescaleFactor;
             
             geometry_msgs::Point position;
-            position.y = (A * sin(a * t + delta)) - 7; // Offset the start and invert;
-            position.x = B * sin(b * t) + 1;
+            position.y = (params.A * sin(params.a * t + params.delta)) - 7; // Offset the start and invert;
+            position.x = params.B * sin(params.b * t) + 1;
             position.z = 0.0;
             return position;
         }
+
+        virtual void positionsAtTimes(const double start, const double increment, const size_t count,
+                double* __restrict__ x, double* __restrict__ y) const {
+            // A plain scalar loop. sin is not vectorized without a vector math library, so the
+            // saving over poseAtTime is the per sample virtual call and message.
+            for(size_t i = 0; i < count; ++i){
+                const double t = (start + i * increment) / params.timescaleFactor;
+                y[i] = (params.A * sin(params.a * t + params.delta)) - 7;
+                x[i] = params.B * sin(params.b * t) + 1;
+            }
+        }
+
+        virtual double headingAtTime(const ros::Duration baseT) const {
+            const double t = baseT.toSec() / params.timescaleFactor;
+
+            // Derivative of the position. The time scale factor is dropped because
+            // it does not change the direction.
+            const double dy = params.A * params.a * cos(params.a * t + params.delta);
+            const double dx = params.B * params.b * cos(params.b * t);
+            return tfAtan2(dy, dx);
+        }
+
+        virtual void headingsAtTimes(const double start, const double increment, const size_t count,
+                const double* /* x */, const double* /* y */, double* __restrict__ yaw) const {
+            for(size_t i = 0; i < count; ++i){
+                const double t = (start + i * increment) / params.timescaleFactor;
+                const double dy = params.A * params.a * cos(params.a * t + params.delta);
+                const double dx = params.B * params.b * cos(params.b * t);
+                yaw[i] = tfAtan2(dy, dx);
+            }
+        }
+
+      private:
+        const LissajousParameters params;
   };
 }
@@ -0,0 +1,167 @@
+#pragma once
+#include <string>
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <dogsim/LockstepTick.h>
+#include <dogsim/LockstepAck.h>
+
+namespace {
+
+  const std::string LOCKSTEP_TICK_TOPIC = "/dogsim/lockstep/tick";
+  const std::string LOCKSTEP_ACK_TOPIC = "/dogsim/lockstep/ack";
+
+  //! Tick acknowledged by a participant that leaves. Ticks are numbered from 1.
+  const unsigned int LOCKSTEP_LEAVE_TICK = 0;
+
+  //! How often a blocked participant checks that ROS is still running, in milliseconds.
+  const long LOCKSTEP_POLL_MS = 100;
+
+  /**
+   * Participant in a lockstep run, where the lockstep plugin holds the world at the
+   * end of every control period until each participant acknowledges it. A node
+   * joins with its first acknowledgement and leaves when the client is destroyed.
+   * Does nothing unless the lockstep parameter is set.
+   *
+   * Nodes that do their work in callbacks call acknowledgeFromQueue. Nodes that run
+   * their own loop call sleepUntil instead of sleeping on a rate, and release when
+   * the loop ends.
+   */
+  class LockstepClient {
+    public:
+      explicit LockstepClient(const std::string& _name) :
+          name(_name), enabled(false), holding(false), hasHeldTick(false), heldTick(0), spinner(1, &queue) {
+          ros::NodeHandle nh;
+          nh.param<bool>("lockstep", enabled, false);
+      }
+
+      ~LockstepClient() {
+          spinner.stop();
+
+          // Leave so the world does not wait for this node any more.
+          if (ackPub) {
+              acknowledge(LOCKSTEP_LEAVE_TICK);
+          }
+      }
+
+      bool isEnabled() const {
+          return enabled;
+      }
+
+      /**
+       * Acknowledge ticks from the node's own callback queue. Everything queued before a
+       * tick has been handled by the time it is acknowledged.
+       */
+      void acknowledgeFromQueue(ros::NodeHandle& nh) {
+          if (!enabled) {
+              return;
+          }
+          ackPub = nh.advertise<dogsim::LockstepAck>(LOCKSTEP_ACK_TOPIC, 100);
+          tickSub = nh.subscribe(LOCKSTEP_TICK_TOPIC, 100, &LockstepClient::acknowledgeTick, this);
+          ROS_INFO("Running in lockstep as %s", name.c_str());
+      }
+
+      /**
+       * Acknowledge the tick the loop last ran on, then block until the world reaches
+       * the given sim time. The world is held on return so the next iteration sees a
+       * frozen world. Ticks in between are acknowledged straight away.
+       * @return False if ROS shut down.
+       */
+      bool sleepUntil(const ros::Time& time) {
+          if (!enabled) {
+              return ros::Time::sleepUntil(time);
+          }
+          startLoop();
+          boost::mutex::scoped_lock lock(mutex);
+          if (hasHeldTick) {
+              acknowledge(heldTick);
+              hasHeldTick = false;
+          }
+          holding = true;
+          wakeTime = time;
+          while (!hasHeldTick && ros::ok()) {
+              tickArrived.timed_wait(lock, boost::posix_time::milliseconds(LOCKSTEP_POLL_MS));
+          }
+          return hasHeldTick;
+      }
+
+      /**
+       * Let the world run freely again once the loop has ended.
+       */
+      void release() {
+          if (!enabled) {
+              return;
+          }
+          boost::mutex::scoped_lock lock(mutex);
+          if (hasHeldTick) {
+              acknowledge(heldTick);
+              hasHeldTick = false;
+          }
+          holding = false;
+      }
+
+    private:
+      /**
+       * Subscribe on a private queue so ticks are acknowledged while the loop is busy.
+       * Until the loop first sleeps, every tick is acknowledged on arrival.
+       */
+      void startLoop() {
+          if (tickSub) {
+              return;
+          }
+          ros::NodeHandle nh;
+          ackPub = nh.advertise<dogsim::LockstepAck>(LOCKSTEP_ACK_TOPIC, 100);
+          nh.setCallbackQueue(&queue);
+          tickSub = nh.subscribe(LOCKSTEP_TICK_TOPIC, 100, &LockstepClient::holdTick, this);
+          spinner.start();
+          ROS_INFO("Running in lockstep as %s", name.c_str());
+      }
+
+      void acknowledgeTick(const dogsim::LockstepTickConstPtr& tick) {
+          acknowledge(tick->tick);
+      }
+
+      void holdTick(const dogsim::LockstepTickConstPtr& tick) {
+          boost::mutex::scoped_lock lock(mutex);
+
+          // A repeat of the held tick. The plugin resends ticks until they are acknowledged.
+          if (hasHeldTick && tick->tick == heldTick) {
+              return;
+          }
+          if (!holding || tick->header.stamp < wakeTime) {
+              acknowledge(tick->tick);
+              return;
+          }
+          heldTick = tick->tick;
+          hasHeldTick = true;
+          tickArrived.notify_all();
+      }
+
+      void acknowledge(const unsigned int tick) {
+          dogsim::LockstepAckPtr ack(new dogsim::LockstepAck());
+          ack->participant = name;
+          ack->tick = tick;
+          ackPub.publish(ack);
+      }
+
+      const std::string name;
+      bool enabled;
+
+      //! Whether a loop is waiting for a tick, and the sim time it is waiting for.
+      bool holding;
+      ros::Time wakeTime;
+
+      //! Tick the loop is running on. Acknowledged when the loop sleeps again.
+      bool hasHeldTick;
+      unsigned int heldTick;
+
+      boost::mutex mutex;
+      boost::condition_variable tickArrived;
+
+      ros::CallbackQueue queue;
+      ros::AsyncSpinner spinner;
+      ros::Subscriber tickSub;
+      ros::Publisher ackPub;
+  };
+}
@@ -0,0 +1,260 @@
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <gazebo/gazebo.hh>
+#include <physics/physics.hh>
+#include <common/common.hh>
+#include <map>
+#include <string>
+#include "lockstep_client.h"
+#include "tick_profiler.h"
+
+namespace {
+using namespace std;
+using namespace gazebo;
+
+//! Default number of physics steps per control period. 10 ms at the default step size.
+const int LOCKSTEP_STEPS_DEFAULT = 10;
+
+//! Wall time between resends of an unacknowledged tick, in milliseconds.
+const long LOCKSTEP_RESEND_MS = 500;
+
+//! Default wall time to wait for a participant before dropping it, in seconds.
+const double LOCKSTEP_TIMEOUT_DEFAULT = 5.0;
+
+/**
+ * Runs the world in lockstep with the control nodes. Attach to a static model.
+ * Every lockstep_steps physics steps the world is held and a tick is published.
+ * The world resumes once every participant has acknowledged it, so each control
+ * period sees the same world state from run to run and the world runs as fast as
+ * the slowest participant allows.
+ *
+ * Participants are the nodes named in lockstep_participants. They join with their
+ * first acknowledgement, so a node that has not started yet does not hold the world.
+ * A participant that does not acknowledge a tick within lockstep_timeout seconds of
+ * wall time is dropped until it acknowledges again, so a node that crashed or exited
+ * without leaving does not hold the world forever.
+ *
+ * The wall time each participant takes to acknowledge is profiled as a stage named
+ * after it, along with the physics time between ticks.
+ */
+class LockstepPlugin : public ModelPlugin {
+public:
+    LockstepPlugin() : stepsPerTick(LOCKSTEP_STEPS_DEFAULT), timeout(LOCKSTEP_TIMEOUT_DEFAULT), steps(0),
+        tick(0), remaining(0), profiler("lockstep_plugin") {
+        ROS_INFO("Creating Lockstep Plugin");
+        physicsStage = profiler.addStage("physics");
+    }
+
+    ~LockstepPlugin() {
+        ROS_INFO("Destroying Lockstep Plugin");
+        if (spinner.get()) {
+            spinner->stop();
+        }
+        profiler.logSummary();
+    }
+
+    void Load(physics::ModelPtr _parent, sdf::ElementPtr /*_sdf*/) {
+        ROS_INFO("Loading Lockstep Plugin");
+        this->world = _parent->GetWorld();
+
+        if (!loadParticipants()) {
+            return;
+        }
+        nh.param<int>("lockstep_steps", stepsPerTick, LOCKSTEP_STEPS_DEFAULT);
+        stepsPerTick = max(stepsPerTick, 1);
+        nh.param<double>("lockstep_timeout", timeout, LOCKSTEP_TIMEOUT_DEFAULT);
+
+        // The latency breakdown is the point of running in lockstep, so always profile.
+        profiler.start(nh, true);
+
+        tickPub = nh.advertise<dogsim::LockstepTick>(LOCKSTEP_TICK_TOPIC, 10);
+
+        // Acknowledgements are handled on their own thread while the physics thread waits.
+        ackNh.setCallbackQueue(&ackQueue);
+        ackSub = ackNh.subscribe(LOCKSTEP_ACK_TOPIC, 100, &LockstepPlugin::onAcknowledge, this);
+        spinner.reset(new ros::AsyncSpinner(1, &ackQueue));
+        spinner->start();
+
+        lastRelease = ros::WallTime::now();
+
+        // Listen to the update event. This event is broadcast every
+        // simulation iteration.
+        this->updateConnection = event::Events::ConnectWorldUpdateBegin(
+                boost::bind(&LockstepPlugin::OnUpdate, this));
+        ROS_INFO("Running the world in lockstep every %d steps with %lu participants", stepsPerTick,
+                participants.size());
+    }
+
+private:
+    struct Participant {
+        Participant() : stage(0), joined(false), waiting(false) {
+        }
+
+        //! Profiler stage of the acknowledgement latency.
+        unsigned int stage;
+        bool joined;
+
+        //! Whether the current tick waits for this participant.
+        bool waiting;
+    };
+
+    /**
+     * Read the node names from the lockstep_participants parameter.
+     */
+    bool loadParticipants() {
+        XmlRpc::XmlRpcValue names;
+        if (!nh.getParam("lockstep_participants", names) || names.getType() != XmlRpc::XmlRpcValue::TypeArray) {
+            ROS_ERROR("Parameter lockstep_participants must be a list of node names");
+            return false;
+        }
+
+        for (int i = 0; i < names.size(); ++i) {
+            if (names[i].getType() != XmlRpc::XmlRpcValue::TypeString) {
+                ROS_ERROR("Lockstep participant %d is not a name", i);
+                return false;
+            }
+            const string name = static_cast<string>(names[i]);
+            participants[name].stage = profiler.addStage(name);
+        }
+        return true;
+    }
+
+    // Called by the world update start event
+    void OnUpdate() {
+        if (++steps < stepsPerTick) {
+            return;
+        }
+        steps = 0;
+        profiler.record(physicsStage, ros::WallTime::now() - lastRelease);
+
+        // Hold the world until every participant that has joined handles the tick.
+        StageTimer tickTimer(profiler, TICK_STAGE);
+        boost::mutex::scoped_lock lock(mutex);
+        ++tick;
+        remaining = 0;
+        for (map<string, Participant>::iterator i = participants.begin(); i != participants.end(); ++i) {
+            i->second.waiting = i->second.joined;
+            remaining += i->second.joined ? 1 : 0;
+        }
+
+        const ros::Time stamp(this->world->GetSimTime().Double());
+        tickTime = ros::WallTime::now();
+        publishTick(stamp);
+
+        const ros::WallTime dropAt = tickTime + ros::WallDuration(timeout);
+        while (remaining > 0 && ros::ok()) {
+            if (acknowledged.timed_wait(lock, boost::posix_time::milliseconds(LOCKSTEP_RESEND_MS))) {
+                continue;
+            }
+            if (ros::WallTime::now() > dropAt) {
+                dropWaiting();
+                break;
+            }
+
+            // Resend in case the tick was dropped.
+            publishTick(stamp);
+        }
+        tickTimer.stop();
+        lastRelease = ros::WallTime::now();
+    }
+
+    void publishTick(const ros::Time& stamp) {
+        dogsim::LockstepTickPtr message(new dogsim::LockstepTick());
+        message->header.stamp = stamp;
+        message->tick = tick;
+        tickPub.publish(message);
+    }
+
+    /**
+     * Drop the participants the tick still waits for. They join again with their next
+     * acknowledgement.
+     */
+    void dropWaiting() {
+        for (map<string, Participant>::iterator i = participants.begin(); i != participants.end(); ++i) {
+            if (i->second.waiting) {
+                ROS_WARN("Dropping %s from the lockstep after it did not acknowledge tick %u for %f s",
+                        i->first.c_str(), tick, timeout);
+                i->second.joined = false;
+                release(i->second);
+            }
+        }
+    }
+
+    void onAcknowledge(const dogsim::LockstepAckConstPtr& ack) {
+        boost::mutex::scoped_lock lock(mutex);
+        map<string, Participant>::iterator i = participants.find(ack->participant);
+        if (i == participants.end()) {
+            ROS_DEBUG("Ignoring lockstep acknowledgement from %s", ack->participant.c_str());
+            return;
+        }
+        Participant& participant = i->second;
+
+        if (ack->tick == LOCKSTEP_LEAVE_TICK) {
+            ROS_INFO("%s left the lockstep", ack->participant.c_str());
+            participant.joined = false;
+            release(participant);
+            return;
+        }
+
+        if (!participant.joined) {
+            ROS_INFO("%s joined the lockstep", ack->participant.c_str());
+            participant.joined = true;
+        }
+
+        // Acknowledgements of resent earlier ticks are ignored.
+        if (ack->tick == tick && participant.waiting) {
+            profiler.record(participant.stage, ros::WallTime::now() - tickTime);
+            release(participant);
+        }
+    }
+
+    void release(Participant& participant) {
+        if (participant.waiting) {
+            participant.waiting = false;
+            if (--remaining == 0) {
+                acknowledged.notify_all();
+            }
+        }
+    }
+
+    ros::NodeHandle nh;
+
+    // Pointer to the world
+    physics::WorldPtr world;
+
+    // Pointer to the update event connection
+    event::ConnectionPtr updateConnection;
+
+    int stepsPerTick;
+    double timeout;
+
+    //! Physics steps since the last tick.
+    int steps;
+
+    //! Current tick and the number of participants it still waits for. Guarded by mutex.
+    unsigned int tick;
+    unsigned int remaining;
+    map<string, Participant> participants;
+    boost::mutex mutex;
+    boost::condition_variable acknowledged;
+
+    //! Wall time the current tick was published and the previous one released.
+    ros::WallTime tickTime;
+    ros::WallTime lastRelease;
+
+    ros::Publisher tickPub;
+    ros::NodeHandle ackNh;
+    ros::CallbackQueue ackQueue;
+    ros::Subscriber ackSub;
+    auto_ptr<ros::AsyncSpinner> spinner;
+
+    TickProfiler profiler;
+    unsigned int physicsStage;
+};
+
+// Register this plugin with the simulator
+GZ_REGISTER_MODEL_PLUGIN (LockstepPlugin);
+}
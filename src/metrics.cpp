@@ -0,0 +1,580 @@
+#include <ros/ros.h>
+#include <fstream>
+#include <iomanip>
+#include <boost/shared_ptr.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/math/special_functions/fpclassify.hpp>
+#include <message_filters/subscriber.h>
+#include <dogsim/utils.h>
+#include <sensor_msgs/JointState.h>
+#include <dogsim/LeashInfoArray.h>
+#include <dogsim/DogPosition.h>
+#include <dogsim/PathViewInfo.h>
+#include <dogsim/GetPath.h>
+#include <dogsim/GetEntireRobotPath.h>
+#include <position_tracker/StartMeasurement.h>
+#include <position_tracker/StopMeasurement.h>
+#include "path_client.h"
+#include "walk_streams.h"
+#include "walk_metrics.h"
+
+namespace {
+using namespace std;
+using namespace ros;
+
+//! Spacing of the planned robot poses. Poses are interpolated, so it only has to resolve the turns.
+const double ROBOT_PATH_INCREMENT = 0.1;
+
+//! Modules run when the metrics parameter is not set.
+const string METRICS_DEFAULT = "path dog_position path_visibility total_force leash_force";
+
+//! Streams a module reads. The node subscribes once to each stream that any module reads.
+enum MetricStream {
+    GROUND_TRUTH_STREAM = 1,
+    LEASH_STREAM = 2,
+    JOINT_STATES_STREAM = 4,
+    DOG_POSITION_STREAM = 8,
+    PATH_VIEW_STREAM = 16
+};
+
+static double distance(const geometry_msgs::Point& a, const geometry_msgs::Point& b) {
+    return sqrt(utils::square(a.x - b.x) + utils::square(a.y - b.y) + utils::square(a.z - b.z));
+}
+
+/**
+ * One metric computed by the metrics node. The node owns the subscriptions and
+ * hands each module the streams it reads.
+ */
+class MetricModule {
+public:
+    virtual ~MetricModule() {
+    }
+
+    //! Mask of the streams the module reads.
+    virtual unsigned int getStreams() const = 0;
+
+    virtual void start(const Time& /*time*/) {
+    }
+
+    virtual void onGroundTruth(const dogsim::GroundTruth& /*truth*/) {
+    }
+
+    virtual void onLeash(const dogsim::LeashInfoArray& /*batch*/) {
+    }
+
+    virtual void onJointState(const sensor_msgs::JointState& /*jointState*/) {
+    }
+
+    virtual void onDogPosition(const dogsim::DogPosition& /*position*/) {
+    }
+
+    virtual void onPathView(const dogsim::PathViewInfo& /*view*/) {
+    }
+
+    /**
+     * Log the results in the format the runner parses and add them to the values.
+     */
+    virtual void stop(const Time& time, MetricValues& values) = 0;
+};
+
+/**
+ * Deviation of the dog from its goal, from every ground truth pose of the dog.
+ * Reports nothing if there was no pose, rather than a deviation of 0.
+ */
+class PathModule : public MetricModule {
+public:
+    explicit PathModule(NodeHandle& nh) : pathClient(nh), metric(getDogHeight(nh)) {
+    }
+
+    unsigned int getStreams() const {
+        return GROUND_TRUTH_STREAM;
+    }
+
+    void onGroundTruth(const dogsim::GroundTruth& truth) {
+        if (!truth.hasDog) {
+            return;
+        }
+        const Time& time = truth.header.stamp;
+        dogsim::GetPath::Response path;
+        if (!pathClient.getPath(time, path)) {
+            ROS_WARN_THROTTLE(1.0, "No path description received yet");
+            return;
+        }
+        if (!path.started || path.ended) {
+            ROS_DEBUG("Received ground truth outside the walk");
+            return;
+        }
+
+        const geometry_msgs::Point& position = truth.dog.position;
+        metric.add(time.toSec(), distance(path.point.point, position), position.z);
+    }
+
+    void stop(const Time& /*time*/, MetricValues& values) {
+        if (metric.getCount() == 0) {
+            ROS_ERROR("Path measurement ended without any ground truth of the dog");
+            return;
+        }
+        MetricValues own;
+        metric.getValues(own);
+        ROS_INFO("Path measurement ended. Total position deviation squared(m): %f", getValue(own, "path_deviation"));
+        ROS_INFO("Mean height deviation: %f", getValue(own, "height_deviation"));
+        values.insert(values.end(), own.begin(), own.end());
+    }
+
+private:
+    static double getDogHeight(NodeHandle& nh) {
+        double dogHeight;
+        nh.param<double>("dog_height", dogHeight, DOG_HEIGHT_DEFAULT);
+        return dogHeight;
+    }
+
+    PathClient pathClient;
+    PathDeviationMetric metric;
+};
+
+/**
+ * Deviation of the robot base from its planned path, from every ground truth pose
+ * of the robot. The planned path is fetched once when measuring starts. Reports
+ * nothing if there was no pose, rather than a deviation of 0.
+ */
+class RobotPathModule : public MetricModule {
+public:
+    explicit RobotPathModule(NodeHandle& _nh) : nh(_nh) {
+    }
+
+    unsigned int getStreams() const {
+        return GROUND_TRUTH_STREAM;
+    }
+
+    void start(const Time& /*time*/) {
+        path = UniformPath();
+
+        // The walk starts before measuring does, so the poses carry its stamps.
+        ServiceClient getPathClient = nh.serviceClient<dogsim::GetEntireRobotPath>("/dogsim/get_entire_robot_path");
+        dogsim::GetEntireRobotPath getPath;
+        getPath.request.increment = ROBOT_PATH_INCREMENT;
+        if (!getPathClient.call(getPath) || getPath.response.poses.empty()) {
+            ROS_ERROR("Failed to fetch the robot path");
+            return;
+        }
+
+        const vector<geometry_msgs::PoseStamped>& poses = getPath.response.poses;
+        path.reset(poses.front().header.stamp.toSec(), ROBOT_PATH_INCREMENT);
+        for (unsigned int i = 0; i < poses.size(); ++i) {
+            path.add(poses[i].pose.position.x, poses[i].pose.position.y, poses[i].pose.position.z);
+        }
+    }
+
+    void onGroundTruth(const dogsim::GroundTruth& truth) {
+        if (path.empty() || !truth.hasRobot) {
+            return;
+        }
+
+        const double time = truth.header.stamp.toSec();
+        geometry_msgs::Point goal;
+        path.positionAt(time, goal.x, goal.y, goal.z);
+        metric.add(time, distance(goal, truth.robot.position));
+    }
+
+    void stop(const Time& /*time*/, MetricValues& values) {
+        if (metric.getCount() == 0) {
+            ROS_ERROR("Robot Path measurement ended without any ground truth of the robot");
+            return;
+        }
+        MetricValues own;
+        metric.getValues(own);
+        ROS_INFO("Robot Path measurement ended. Total position deviation squared(m): %f",
+                getValue(own, "robot_deviation"));
+        values.insert(values.end(), own.begin(), own.end());
+    }
+
+private:
+    NodeHandle nh;
+    UniformPath path;
+    RobotPathDeviationMetric metric;
+};
+
+/**
+ * Force on the leash and how far it stretched.
+ */
+class LeashForceModule : public MetricModule {
+public:
+    explicit LeashForceModule(NodeHandle& nh) : metric(getLeashLength(nh)) {
+    }
+
+    unsigned int getStreams() const {
+        return LEASH_STREAM;
+    }
+
+    void onLeash(const dogsim::LeashInfoArray& batch) {
+        for (unsigned int i = 0; i < batch.samples.size(); ++i) {
+            const dogsim::LeashInfo& leashState = batch.samples[i];
+            const double force = sqrt(utils::square(leashState.force.x) + utils::square(leashState.force.y)
+                    + utils::square(leashState.force.z));
+            metric.add(leashState.header.stamp.toSec(), force, leashState.distance);
+        }
+    }
+
+    void stop(const Time& /*time*/, MetricValues& values) {
+        MetricValues own;
+        metric.getValues(own);
+        ROS_INFO("Total leash force(N): %f", getValue(own, "leash_force"));
+        ROS_INFO("Mean Leash Stretch: %f, Leash Stretch Variance: %f, Maximum Leash Stretch: %f",
+                getValue(own, "stretch_mean"), getValue(own, "stretch_variance"), getValue(own, "stretch_max"));
+        values.insert(values.end(), own.begin(), own.end());
+    }
+
+private:
+    static double getLeashLength(NodeHandle& nh) {
+        double leashLength;
+        nh.param<double>("leash_length", leashLength, LEASH_LENGTH_DEFAULT);
+        return leashLength;
+    }
+
+    LeashForceMetric metric;
+};
+
+/**
+ * Effort exerted by the robot's joints.
+ */
+class TotalForceModule : public MetricModule {
+public:
+    unsigned int getStreams() const {
+        return JOINT_STATES_STREAM;
+    }
+
+    void onJointState(const sensor_msgs::JointState& jointState) {
+        metric.add(jointState.header.stamp.toSec(), jointState.effort);
+    }
+
+    void stop(const Time& /*time*/, MetricValues& values) {
+        MetricValues own;
+        metric.getValues(own);
+        ROS_INFO("Total force(Nm): %f", getValue(own, "total_force"));
+        values.insert(values.end(), own.begin(), own.end());
+    }
+
+private:
+    JointEffortMetric metric;
+};
+
+/**
+ * Accuracy and latency of the dog position detector against the dog's true pose.
+ */
+class DogPositionModule : public MetricModule {
+public:
+    explicit DogPositionModule(NodeHandle& pnh) : hasPose(false) {
+        pnh.param<string>("model_name", modelName, "dog");
+    }
+
+    unsigned int getStreams() const {
+        return GROUND_TRUTH_STREAM | DOG_POSITION_STREAM;
+    }
+
+    void start(const Time& time) {
+        metric.start(time.toSec());
+    }
+
+    void onGroundTruth(const dogsim::GroundTruth& truth) {
+        if (truth.hasDog && truth.dogName == modelName) {
+            modelPosition = truth.dog.position;
+            hasPose = true;
+        }
+    }
+
+    void onDogPosition(const dogsim::DogPosition& dogPosition) {
+        const double stamp = dogPosition.header.stamp.toSec();
+        if (dogPosition.unknown) {
+            metric.addUnknown(stamp);
+            return;
+        }
+        if (!hasPose) {
+            return;
+        }
+
+        // Do not include z position because it is not tracked
+        const geometry_msgs::Point& estimatedPosition = dogPosition.pose.pose.position;
+        const double deviation = sqrt(utils::square(modelPosition.x - estimatedPosition.x)
+                + utils::square(modelPosition.y - estimatedPosition.y));
+        metric.addKnown(stamp, deviation, Time::now().toSec());
+    }
+
+    void stop(const Time& time, MetricValues& values) {
+        MetricValues own;
+        metric.getValues(time.toSec(), own);
+        ROS_INFO(
+                "Total Known Time: %f, Total Unknown Time: %f, Total Time: %f, Percent Known: %f, Percent Unknown: %f",
+                getValue(own, "known_time"), getValue(own, "unknown_time"), getValue(own, "total_time"),
+                getValue(own, "percent_known"), getValue(own, "percent_unknown"));
+        ROS_INFO("Mean Position Deviation: %f, Position Variance: %f", getValue(own, "position_deviation_mean"),
+                getValue(own, "position_deviation_variance"));
+        ROS_INFO("Mean Time Duration: %f, Time Variance: %f", getValue(own, "latency_mean"),
+                getValue(own, "latency_variance"));
+        ROS_INFO("Mean Unknown Time Duration: %f, Unknown Time Variance: %f", getValue(own, "unknown_duration_mean"),
+                getValue(own, "unknown_duration_variance"));
+        values.insert(values.end(), own.begin(), own.end());
+    }
+
+private:
+    string modelName;
+    bool hasPose;
+    geometry_msgs::Point modelPosition;
+    DogTrackingMetric metric;
+};
+
+/**
+ * How much of the path the robot kept in view.
+ */
+class PathVisibilityModule : public MetricModule {
+public:
+    unsigned int getStreams() const {
+        return PATH_VIEW_STREAM;
+    }
+
+    void start(const Time& time) {
+        metric.start(time.toSec());
+    }
+
+    void onPathView(const dogsim::PathViewInfo& view) {
+        metric.add(view.header.stamp.toSec(), view.visibilityRatio);
+    }
+
+    void stop(const Time& time, MetricValues& values) {
+        MetricValues own;
+        metric.getValues(time.toSec(), own);
+        ROS_INFO("Total path visibility score was %f over %f seconds", getValue(own, "visibility_score"),
+                getValue(own, "visibility_time"));
+        values.insert(values.end(), own.begin(), own.end());
+    }
+
+private:
+    PathVisibilityMetric metric;
+};
+
+/**
+ * Scores a walk between start_measuring and stop_measuring. Runs the metric modules
+ * named in the metrics parameter with one subscription per stream, logs each
+ * result and writes them all to results_file as JSON if it is set. Ground truth
+ * comes from the model states while the dog model plugin publishes none.
+ */
+class MetricsNode {
+private:
+    NodeHandle nh;
+    NodeHandle pnh;
+
+    vector<boost::shared_ptr<MetricModule> > modules;
+
+    //! Mask of the streams any module reads.
+    unsigned int streams;
+
+    bool measuring;
+    string resultsFile;
+
+    //! Sim and wall time measuring started, to report how fast the world ran.
+    Time startTime;
+    WallTime startWallTime;
+
+    //! Ground truth while the dog model plugin publishes none.
+    ModelStatesGroundTruth modelStatesGroundTruth;
+
+    message_filters::Subscriber<position_tracker::StartMeasurement> startMeasuringSub;
+    message_filters::Subscriber<position_tracker::StopMeasurement> stopMeasuringSub;
+
+    Subscriber groundTruthSub;
+    Subscriber modelStatesSub;
+    Subscriber leashSub;
+    Subscriber jointStateSub;
+    Subscriber dogPositionSub;
+    Subscriber pathViewSub;
+
+public:
+    MetricsNode() :
+            pnh("~"), streams(0), measuring(false), modelStatesGroundTruth(getModelName(pnh)), startMeasuringSub(
+                    nh, "start_measuring", 1), stopMeasuringSub(nh, "stop_measuring", 1) {
+        string metrics;
+        pnh.param<string>("metrics", metrics, METRICS_DEFAULT);
+        pnh.param<string>("results_file", resultsFile, "");
+
+        vector<string> names;
+        boost::split(names, metrics, boost::is_any_of(", "), boost::token_compress_on);
+        for (unsigned int i = 0; i < names.size(); ++i) {
+            if (names[i].empty()) {
+                continue;
+            }
+            boost::shared_ptr<MetricModule> module(createModule(names[i]));
+            if (!module.get()) {
+                ROS_ERROR("Unknown metric %s", names[i].c_str());
+                continue;
+            }
+            modules.push_back(module);
+            streams |= module->getStreams();
+            ROS_INFO("Measuring %s", names[i].c_str());
+        }
+
+        startMeasuringSub.registerCallback(boost::bind(&MetricsNode::startMeasuring, this, _1));
+        stopMeasuringSub.registerCallback(boost::bind(&MetricsNode::stopMeasuring, this, _1));
+    }
+
+private:
+    static string getModelName(NodeHandle& pnh) {
+        string modelName;
+        pnh.param<string>("model_name", modelName, "dog");
+        return modelName;
+    }
+
+    MetricModule* createModule(const string& name) {
+        if (name == "path") {
+            return new PathModule(nh);
+        }
+        if (name == "robot_path") {
+            return new RobotPathModule(nh);
+        }
+        if (name == "leash_force") {
+            return new LeashForceModule(nh);
+        }
+        if (name == "total_force") {
+            return new TotalForceModule();
+        }
+        if (name == "dog_position") {
+            return new DogPositionModule(pnh);
+        }
+        if (name == "path_visibility") {
+            return new PathVisibilityModule();
+        }
+        return NULL;
+    }
+
+    void startMeasuring(const position_tracker::StartMeasurementConstPtr msg) {
+        if (measuring) {
+            return;
+        }
+        measuring = true;
+        startTime = Time::now();
+        startWallTime = WallTime::now();
+        for (unsigned int i = 0; i < modules.size(); ++i) {
+            modules[i]->start(msg->header.stamp);
+        }
+
+        if (streams & GROUND_TRUTH_STREAM) {
+            groundTruthSub = nh.subscribe(GROUND_TRUTH_TOPIC, GROUND_TRUTH_QUEUE_SIZE,
+                    &MetricsNode::groundTruthCallback, this, TransportHints().tcpNoDelay());
+            modelStatesSub = nh.subscribe(MODEL_STATES_TOPIC, GROUND_TRUTH_QUEUE_SIZE,
+                    &MetricsNode::modelStatesCallback, this, TransportHints().tcpNoDelay());
+        }
+        if (streams & LEASH_STREAM) {
+            leashSub = nh.subscribe(LEASH_TOPIC, STREAM_QUEUE_SIZE, &MetricsNode::leashCallback, this);
+        }
+        if (streams & JOINT_STATES_STREAM) {
+            jointStateSub = nh.subscribe(JOINT_STATES_TOPIC, STREAM_QUEUE_SIZE, &MetricsNode::jointStateCallback, this);
+        }
+        if (streams & DOG_POSITION_STREAM) {
+            dogPositionSub = nh.subscribe(DOG_POSITION_TOPIC, STREAM_QUEUE_SIZE,
+                    &MetricsNode::dogPositionCallback, this);
+        }
+        if (streams & PATH_VIEW_STREAM) {
+            pathViewSub = nh.subscribe(PATH_VIEW_TOPIC, STREAM_QUEUE_SIZE, &MetricsNode::pathViewCallback, this);
+        }
+        ROS_INFO("Measurement initiated");
+    }
+
+    void stopMeasuring(const position_tracker::StopMeasurementConstPtr msg) {
+        if (!measuring) {
+            return;
+        }
+        measuring = false;
+        groundTruthSub.shutdown();
+        modelStatesSub.shutdown();
+        leashSub.shutdown();
+        jointStateSub.shutdown();
+        dogPositionSub.shutdown();
+        pathViewSub.shutdown();
+
+        MetricValues values;
+        for (unsigned int i = 0; i < modules.size(); ++i) {
+            modules[i]->stop(msg->header.stamp, values);
+        }
+
+        const double simDuration = (Time::now() - startTime).toSec();
+        const double wallDuration = (WallTime::now() - startWallTime).toSec();
+        const double speedup = wallDuration > 0 ? simDuration / wallDuration : 0.0;
+        ROS_INFO("Measured %f s of sim time in %f s of wall time. Speedup: %f", simDuration, wallDuration, speedup);
+        values.push_back(make_pair("sim_time", simDuration));
+        values.push_back(make_pair("measured_wall_time", wallDuration));
+        values.push_back(make_pair("speedup", speedup));
+
+        writeResults(values);
+    }
+
+    void writeResults(const MetricValues& values) const {
+        if (resultsFile.empty()) {
+            return;
+        }
+        ofstream out(resultsFile.c_str());
+        out << setprecision(12) << "{";
+        for (unsigned int i = 0; i < values.size(); ++i) {
+            out << (i > 0 ? "," : "") << endl << "  \"" << values[i].first << "\": ";
+            if ((boost::math::isfinite)(values[i].second)) {
+                out << values[i].second;
+            }
+            else {
+                out << "null";
+            }
+        }
+        out << endl << "}" << endl;
+
+        if (!out) {
+            ROS_ERROR("Failed to write the results to %s", resultsFile.c_str());
+            return;
+        }
+        ROS_INFO("Wrote the results to %s", resultsFile.c_str());
+    }
+
+    void groundTruthCallback(const dogsim::GroundTruthConstPtr& truth) {
+        modelStatesGroundTruth.onGroundTruth(*truth);
+        for (unsigned int i = 0; i < modules.size(); ++i) {
+            modules[i]->onGroundTruth(*truth);
+        }
+    }
+
+    void modelStatesCallback(const gazebo_msgs::ModelStatesConstPtr& states) {
+        dogsim::GroundTruth truth;
+        if (!modelStatesGroundTruth.convert(*states, truth)) {
+            return;
+        }
+        for (unsigned int i = 0; i < modules.size(); ++i) {
+            modules[i]->onGroundTruth(truth);
+        }
+    }
+
+    void leashCallback(const dogsim::LeashInfoArrayConstPtr& batch) {
+        for (unsigned int i = 0; i < modules.size(); ++i) {
+            modules[i]->onLeash(*batch);
+        }
+    }
+
+    void jointStateCallback(const sensor_msgs::JointStateConstPtr& jointState) {
+        for (unsigned int i = 0; i < modules.size(); ++i) {
+            modules[i]->onJointState(*jointState);
+        }
+    }
+
+    void dogPositionCallback(const dogsim::DogPositionConstPtr& position) {
+        for (unsigned int i = 0; i < modules.size(); ++i) {
+            modules[i]->onDogPosition(*position);
+        }
+    }
+
+    void pathViewCallback(const dogsim::PathViewInfoConstPtr& view) {
+        for (unsigned int i = 0; i < modules.size(); ++i) {
+            modules[i]->onPathView(*view);
+        }
+    }
+};
+}
+
+int main(int argc, char **argv) {
+    ros::init(argc, argv, "metrics");
+    MetricsNode metrics;
+    ros::spin();
+    return 0;
+}
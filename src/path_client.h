@@ -0,0 +1,111 @@
+#pragma once
+#include <string>
+#include <ros/ros.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <dogsim/GetPath.h>
+#include <dogsim/PathDescription.h>
+#include "path_provider_factory.h"
+
+namespace {
+
+  //! Latched topic the get path server describes the walk on.
+  const std::string PATH_DESCRIPTION_TOPIC = "/dogsim/path_description";
+
+  /**
+   * Resolve a get path server topic for a walk session. The default session
+   * keeps the original /dogsim topics, others are namespaced under /dogsim/<session>.
+   */
+  static std::string getSessionTopic(const std::string& session, const std::string& topic) {
+      if (session.empty()) {
+          return topic;
+      }
+      const std::string prefix = "/dogsim/";
+      return prefix + session + "/" + topic.substr(prefix.size());
+  }
+
+  /**
+   * Fill in a get path response for the time. Shared by the get path server and
+   * PathClient so both answer identically.
+   */
+  static void computePath(const PathProvider& provider, const bool started, const ros::Time& startTime,
+          const ros::Time& time, dogsim::GetPath::Response& res) {
+      res.elapsedTime = time - startTime;
+      res.started = started;
+      res.ended = started && res.elapsedTime > provider.getMaximumTime();
+
+      // Allow calling get path prior to starting and return the begin position.
+      res.point.header.frame_id = "/map";
+      res.point.point = provider.positionAtTime(started ? res.elapsedTime : ros::Duration(0));
+  }
+
+  /**
+   * Evaluates the walk locally from the latched path description rather than
+   * calling the get path service.
+   */
+  class PathClient {
+    public:
+      /**
+       * @param nh Node handle to subscribe with. Its callback queue delivers the descriptions.
+       * @param session Walk session to follow. Empty for the default walk.
+       */
+      PathClient(ros::NodeHandle& nh, const std::string& session = "") : started(false) {
+          descriptionSub = nh.subscribe(getSessionTopic(session, PATH_DESCRIPTION_TOPIC), 1,
+                  &PathClient::descriptionCallback, this);
+      }
+
+      /**
+       * Whether a description has been received.
+       */
+      bool isReady() const {
+          boost::mutex::scoped_lock lock(mutex);
+          return provider.get() != NULL;
+      }
+
+      /**
+       * Answer the same query as the get path service.
+       * @return False if no description has been received yet.
+       */
+      bool getPath(const ros::Time& time, dogsim::GetPath::Response& res) const {
+          boost::mutex::scoped_lock lock(mutex);
+          if (!provider.get()) {
+              return false;
+          }
+          computePath(*provider, started, startTime, time, res);
+          return true;
+      }
+
+      /**
+       * The reconstructed provider, or NULL if no description has been received yet.
+       */
+      boost::shared_ptr<const PathProvider> getProvider() const {
+          boost::mutex::scoped_lock lock(mutex);
+          return provider;
+      }
+
+    private:
+      void descriptionCallback(const dogsim::PathDescriptionConstPtr& description) {
+          boost::shared_ptr<PathProvider> newProvider(createPathProvider(*description));
+          if (!newProvider.get()) {
+              ROS_ERROR("Received an invalid description for path type %s", description->pathType.c_str());
+              return;
+          }
+          newProvider->init();
+
+          boost::mutex::scoped_lock lock(mutex);
+          provider = newProvider;
+          started = description->started;
+          startTime = description->startTime;
+          ROS_DEBUG("Received %s path description. Started: %d", description->pathType.c_str(), started);
+      }
+
+      ros::Subscriber descriptionSub;
+
+      //! Guards the provider and start state against the subscriber callback.
+      mutable boost::mutex mutex;
+
+      boost::shared_ptr<const PathProvider> provider;
+      bool started;
+      ros::Time startTime;
+  };
+}
@@ -6,12 +6,16 @@
 #include <costmap_2d/costmap_2d_ros.h>
 #include <dwa_local_planner/dwa_planner_ros.h>
 #include <dogsim/NextGoal.h>
-#include <dogsim/GetEntireRobotPath.h>
+#include <dogsim/GetPathPage.h>
+#include "lockstep_client.h"
 
 namespace {
 using namespace std;
 using namespace dogsim;
 
+//! Spacing of the robot path poses.
+const double PATH_INCREMENT = 0.25;
+
 class PathPlanner {
 private:
 
@@ -40,15 +44,18 @@ private:
     bool running;
 
     //! Cached service client.
-    ros::ServiceClient getEntireRobotPathClient;
+    ros::ServiceClient getRobotPathPageClient;
+
+    //! Holds the world while a velocity command is computed when in lockstep.
+    LockstepClient lockstep;
 
 public:
 	PathPlanner() :
-		pnh("~"), tf(ros::Duration(10), true), costmap("local_costmap", tf) {
+		pnh("~"), tf(ros::Duration(10), true), costmap("local_costmap", tf), lockstep("path_planner") {
 
-        ros::service::waitForService("/dogsim/get_entire_robot_path");
+        ros::service::waitForService("/dogsim/get_robot_path_page");
 
-        getEntireRobotPathClient = nh.serviceClient<GetEntireRobotPath>("/dogsim/get_entire_robot_path", true /* persist */);
+        getRobotPathPageClient = nh.serviceClient<GetPathPage>("/dogsim/get_robot_path_page", true /* persist */);
 
         ros::SubscriberStatusCallback connectCB = boost::bind(&PathPlanner::startListening,
                 this);
@@ -75,28 +82,61 @@ public:
             costmap.resume();
             running = true;
             publishCurrentPlan();
+            lockstep.release();
         }
     }
 
-    bool publishCurrentPlan(){
-        assert(tp.isInitialized());
-
-        GetEntireRobotPath getPath;
-        getPath.request.increment = 0.25;
-        getEntireRobotPathClient.call(getPath);
-        ROS_INFO("Path has %lu poses", getPath.response.poses.size());
-
-        if (getPath.response.poses.size() == 0) {
+    /**
+     * Fetch the robot poses from the first pose after now until the lookahead.
+     * @param path Filled with the poses in the window
+     * @param last Set when the window starts at the last pose of the path
+     */
+    bool getLookaheadPath(const ros::Duration& lookahead, vector<geometry_msgs::PoseStamped>& path, bool& last) {
+        GetPathPage getPage;
+        getPage.request.increment = PATH_INCREMENT;
+
+        // The first call learns the start time and length of the path.
+        getPage.request.offset = 0;
+        getPage.request.count = 0;
+        if (!getRobotPathPageClient.call(getPage) || getPage.response.total == 0) {
             ROS_ERROR("No goal poses sent to local planner");
             return false;
         }
-
-        if (getPath.response.poses[0].header.frame_id != costmap.getGlobalFrameID()) {
-            ROS_ERROR("Goal frame %s must match costmap frame %s",
-                    getPath.response.poses[0].header.frame_id.c_str(), costmap.getGlobalFrameID().c_str());
+        const unsigned int total = getPage.response.total;
+
+        // Index of the first pose after a time. We always want to include the last pose
+        // if there are no future poses.
+        const ros::Time now = ros::Time::now();
+        const double elapsed = (now - getPage.response.startTime).toSec();
+        const unsigned int first = min(static_cast<unsigned int>(max(floor(elapsed / PATH_INCREMENT) + 1, 0.0)), total - 1);
+        const unsigned int end = min(static_cast<unsigned int>(max(floor((elapsed + lookahead.toSec()) / PATH_INCREMENT) + 1, 0.0)), total);
+
+        getPage.request.offset = first;
+        getPage.request.count = max(end, first + 1) - first;
+        if (!getRobotPathPageClient.call(getPage)) {
+            ROS_ERROR("Failed to fetch the robot path");
             return false;
         }
+        path = getPage.response.poses;
+        last = first == total - 1;
+        return path.size() > 0;
+    }
 
+    /**
+     * Wait for the next cycle. In lockstep this also acknowledges the tick the cycle
+     * ran on, so every path through the loop must end here or the world stays held.
+     */
+    void sleepCycle(ros::Rate& updateRate) {
+        if (lockstep.isEnabled()) {
+            lockstep.sleepUntil(ros::Time::now() + updateRate.expectedCycleTime());
+        }
+        else {
+            updateRate.sleep();
+        }
+    }
+
+    bool publishCurrentPlan(){
+        assert(tp.isInitialized());
 
         // Loop over the path and select the next target at each callback
         ros::Duration pathUpdateRate(2, 0);
@@ -113,36 +153,32 @@ public:
             if (!costmap.getRobotPose(globalPose)) {
                 ROS_ERROR(
                         "Cannot make a plan because the local planner could not get the start pose of the robot");
+                sleepCycle(updateRate);
                 continue;
             }
 
             const ros::Time nextUpdateTime = ros::Time::now() + pathUpdateRate;
 
             ROS_DEBUG("Recomputing path segment");
-            vector<geometry_msgs::PoseStamped>::const_iterator i;
 
-            // We always want to include the last pose if there are no
-            // future poses.
-            for (i = getPath.response.poses.begin(); i != getPath.response.poses.end() - 1; ++i) {
-                if (i->header.stamp > ros::Time::now()) {
-                    break;
-                }
+            // Create a list of all future poses.
+            vector<geometry_msgs::PoseStamped> currentPath;
+            bool lastPose;
+            if (!getLookaheadPath(pathLookahead, currentPath, lastPose)) {
+                return false;
             }
+            assert(currentPath.size() > 0 && "No poses in current path");
 
-            vector<geometry_msgs::PoseStamped>::const_iterator j;
-            for (j = i; j != getPath.response.poses.end(); ++j) {
-                if (j->header.stamp > ros::Time::now() + pathLookahead) {
-                    break;
-                }
+            if (currentPath[0].header.frame_id != costmap.getGlobalFrameID()) {
+                ROS_ERROR("Goal frame %s must match costmap frame %s",
+                        currentPath[0].header.frame_id.c_str(), costmap.getGlobalFrameID().c_str());
+                return false;
             }
 
-            // Create a list of all future poses.
-            const vector<geometry_msgs::PoseStamped> currentPath = vector<geometry_msgs::PoseStamped>(i, j);
-            assert(currentPath.size() > 0 && "No poses in current path");
-
             ROS_DEBUG("Setting plan for local planner");
             if (!tp.setPlan(currentPath)) {
                 ROS_ERROR("Failed to set plan");
+                sleepCycle(updateRate);
                 continue;
             }
 
@@ -169,7 +205,7 @@ public:
 
                 // Process any callbacks
                 ros::spinOnce();
-                updateRate.sleep();
+                sleepCycle(updateRate);
             }
 
             if(tp.isGoalReached()){
@@ -182,7 +218,7 @@ public:
                 ROS_INFO("Exiting due to system failure");
             }
 
-            if(i == getPath.response.poses.end() - 1 && tp.isGoalReached()){
+            if(lastPose && tp.isGoalReached()){
                 ROS_DEBUG("Path completed successfully");
                 break;
             }
@@ -2,40 +2,110 @@
 #include <geometry_msgs/Point.h>
 #include <tf/transform_listener.h>
 #include <tf2/LinearMath/btVector3.h>
+#include <vector>
+#include <dogsim/PathDescription.h>
 
 namespace {
 
 
   const ros::Duration SLOPE_DELTA(0.01);
 
+  /**
+   * Poses sampled along a path stored as contiguous arrays so they can be
+   * filled and read without per sample message overhead.
+   */
+  struct PathSamples {
+      std::vector<double> x;
+      std::vector<double> y;
+      std::vector<double> yaw;
+
+      void resize(const size_t count){
+          x.resize(count);
+          y.resize(count);
+          yaw.resize(count);
+      }
+
+      size_t size() const {
+          return x.size();
+      }
+  };
+
   class PathProvider {
     public:
 	    virtual ~PathProvider(){};
         virtual void init() = 0;
         virtual ros::Duration getMaximumTime() const = 0;
 
+        /**
+         * Fill in the path type and parameters so the path can be reconstructed elsewhere.
+         */
+        virtual void describe(dogsim::PathDescription& description) const = 0;
+
         geometry_msgs::PoseStamped poseAtTime(const ros::Duration baseT) const {
             geometry_msgs::PoseStamped goal;
             goal.header.frame_id = "/map";
             goal.pose.position = positionAtTime(baseT);
 
-            geometry_msgs::PoseStamped goal2;
-            goal2.header.frame_id = "/map";
-            goal2.pose.position = positionAtTime(baseT + SLOPE_DELTA);
-
-            // Calculate the vector of the tangent line.
-            btVector3 tangent = btVector3(goal2.pose.position.x, goal2.pose.position.y, 0)
-                            - btVector3(goal.pose.position.x, goal.pose.position.y, 0);
-            tangent.normalize();
-
             // Calculate the yaw so we can create an orientation.
-            tfScalar yaw = tfAtan2(tangent.y(), tangent.x());
-            goal.pose.orientation = tf::createQuaternionMsgFromYaw(yaw);
+            goal.pose.orientation = tf::createQuaternionMsgFromYaw(headingAtTime(baseT));
 
             return goal;
         }
-    protected:
+
+        /**
+         * Sample count poses starting at start and spaced by increment seconds.
+         * Yaw is computed the same way as poseAtTime. The increment may be zero or
+         * negative, though providers are fastest when it is positive.
+         */
+        void samplePoses(const double start, const double increment, const size_t count, PathSamples& samples) const {
+            samples.resize(count);
+            if(count == 0){
+                return;
+            }
+
+            positionsAtTimes(start, increment, count, &samples.x[0], &samples.y[0]);
+            headingsAtTimes(start, increment, count, &samples.x[0], &samples.y[0], &samples.yaw[0]);
+        }
+
+        /**
+         * Calculate the direction of travel along the path. Subclasses with a closed form
+         * tangent override this. Otherwise it is approximated with a finite difference.
+         */
+        virtual double headingAtTime(const ros::Duration baseT) const {
+            const geometry_msgs::Point position = positionAtTime(baseT);
+            const geometry_msgs::Point nextPosition = positionAtTime(baseT + SLOPE_DELTA);
+            return tfAtan2(nextPosition.y - position.y, nextPosition.x - position.x);
+        }
+
+        /**
+         * Fill yaw with the headings at count evenly spaced times. x and y hold the positions
+         * at the same times for use by the finite difference.
+         */
+        virtual void headingsAtTimes(const double start, const double increment, const size_t count,
+                const double* x, const double* y, double* yaw) const {
+            std::vector<double> nextX(count);
+            std::vector<double> nextY(count);
+            positionsAtTimes(start + SLOPE_DELTA.toSec(), increment, count, &nextX[0], &nextY[0]);
+
+            for(size_t i = 0; i < count; ++i){
+                yaw[i] = tfAtan2(nextY[i] - y[i], nextX[i] - x[i]);
+            }
+        }
+
         virtual geometry_msgs::Point positionAtTime(const ros::Duration baseT) const = 0;
+
+        /**
+         * Fill x and y with the positions at count evenly spaced times. Subclasses
+         * override this with a loop that avoids a virtual call per sample.
+         */
+        virtual void positionsAtTimes(const double start, const double increment, const size_t count,
+                double* x, double* y) const {
+            for(size_t i = 0; i < count; ++i){
+                const geometry_msgs::Point position = positionAtTime(ros::Duration(start + i * increment));
+                x[i] = position.x;
+                y[i] = position.y;
+            }
+        }
   };
 }
 
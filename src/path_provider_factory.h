@@ -0,0 +1,61 @@
+#pragma once
+#include <string>
+#include "path_provider.h"
+#include "lissajous_path_provider.h"
+#include "rectangle_path_provider.h"
+#include "block_walk_path_provider.h"
+#include "random_walk_path_provider.h"
+#include "segment_list_path_provider.h"
+#include <dogsim/PathDescription.h>
+
+namespace {
+
+  /**
+   * Create an uninitialized path provider for the given path type.
+   * @param pathType One of lissajous, rectangle, blockwalk or randomwalk.
+   * @return The provider, or NULL if the type is unknown.
+   */
+  static PathProvider* createPathProvider(const std::string& pathType) {
+      if (pathType == "lissajous") {
+          return new LissajousPathProvider();
+      } else if (pathType == "rectangle") {
+          return new RectanglePathProvider();
+      } else if (pathType == "blockwalk") {
+          return new BlockWalkPathProvider();
+      } else if (pathType == "randomwalk") {
+          return new RandomWalkPathProvider();
+      }
+      return NULL;
+  }
+
+  /**
+   * Reconstruct an uninitialized path provider from its description.
+   * @return The provider, or NULL if the description has no parameters.
+   */
+  static PathProvider* createPathProvider(const dogsim::PathDescription& description) {
+      if (description.pathType == "lissajous") {
+          LissajousParameters params;
+          params.a = description.a;
+          params.b = description.b;
+          params.A = description.A;
+          params.B = description.B;
+          params.delta = description.delta;
+          params.timescaleFactor = description.timescaleFactor;
+          params.fullCycleT = description.fullCycleT;
+          return new LissajousPathProvider(params);
+      }
+
+      if (description.segmentLengths.empty()
+              || description.segmentLengths.size() != description.segmentDirections.size()) {
+          return NULL;
+      }
+      std::vector<btVector3> segments(description.segmentLengths.size());
+      for (unsigned int i = 0; i < segments.size(); ++i) {
+          segments[i] = btVector3(description.segmentDirections[i].x,
+                  description.segmentDirections[i].y, description.segmentDirections[i].z);
+          segments[i].setW(btScalar(description.segmentLengths[i]));
+      }
+      return new SegmentListPathProvider(description.pathType, segments,
+              description.roundingDistance, description.velocity);
+  }
+}
@@ -0,0 +1,186 @@
+#include <ros/ros.h>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+#include <tf/transform_datatypes.h>
+#include <dogsim/utils.h>
+#include <dogsim/GetPath.h>
+#include "path_provider_factory.h"
+#include "path_client.h"
+#include "arguments.h"
+
+/**
+ * Times PathProvider::samplePoses against the per sample poseAtTime loop it
+ * replaced in get_path_server, and checks that both give the same poses.
+ *
+ * With round_trips:=N it instead times the /dogsim/get_path call the dog model
+ * plugin made every update against the local evaluation from the path description
+ * that replaced it, and checks that both give the same goal. This needs a running
+ * get_path_server, whose path type is used rather than path_type.
+ *
+ * Parameters are passed as name:=value, e.g.
+ * path_sampling_benchmark path_type:=rectangle samples:=1000000 repeats:=5
+ * path_sampling_benchmark round_trips:=10000
+ */
+namespace {
+using namespace std;
+
+const int SAMPLES_DEFAULT = 1000000;
+const int REPEATS_DEFAULT = 5;
+
+//! Wall time to wait for get_path_server and its path description.
+const double SERVER_TIMEOUT = 10.0;
+
+/**
+ * Difference of two angles wrapped to [0, pi].
+ */
+static double angleError(const double a, const double b) {
+    return fabs(atan2(sin(a - b), cos(a - b)));
+}
+
+/**
+ * Time one update's goal lookup both ways at times spread over the walk.
+ */
+static int benchmarkRoundTrips(const int roundTrips) {
+    ros::NodeHandle nh;
+    PathClient pathClient(nh);
+    ros::ServiceClient getPathClient = nh.serviceClient<dogsim::GetPath>("/dogsim/get_path", true);
+    if (!getPathClient.waitForExistence(ros::Duration(SERVER_TIMEOUT))) {
+        ROS_ERROR("get_path_server is not running");
+        return 1;
+    }
+    const ros::WallTime deadline = ros::WallTime::now() + ros::WallDuration(SERVER_TIMEOUT);
+    while (!pathClient.isReady() && ros::WallTime::now() < deadline) {
+        ros::spinOnce();
+        ros::WallDuration(0.01).sleep();
+    }
+    if (!pathClient.isReady()) {
+        ROS_ERROR("No path description received");
+        return 1;
+    }
+
+    const double increment = pathClient.getProvider()->getMaximumTime().toSec() / roundTrips;
+    vector<geometry_msgs::Point> remote(roundTrips);
+    vector<geometry_msgs::Point> local(roundTrips);
+
+    ros::WallTime start = ros::WallTime::now();
+    for (int i = 0; i < roundTrips; ++i) {
+        dogsim::GetPath getPath;
+        getPath.request.time = ros::Time(1.0 + i * increment);
+        if (!getPathClient.call(getPath)) {
+            ROS_ERROR("Failed to call get_path");
+            return 1;
+        }
+        remote[i] = getPath.response.point.point;
+    }
+    const double remoteTime = (ros::WallTime::now() - start).toSec();
+
+    start = ros::WallTime::now();
+    for (int i = 0; i < roundTrips; ++i) {
+        dogsim::GetPath::Response path;
+        pathClient.getPath(ros::Time(1.0 + i * increment), path);
+        local[i] = path.point.point;
+    }
+    const double localTime = (ros::WallTime::now() - start).toSec();
+
+    double positionError = 0;
+    for (int i = 0; i < roundTrips; ++i) {
+        positionError = max(positionError, sqrt(utils::square(remote[i].x - local[i].x)
+                + utils::square(remote[i].y - local[i].y) + utils::square(remote[i].z - local[i].z)));
+    }
+
+    printf("round_trips %d get_path %f us local %f us speedup %f position_error %g m\n", roundTrips,
+            remoteTime / roundTrips * 1e6, localTime / roundTrips * 1e6, localTime > 0 ? remoteTime / localTime : 0.0,
+            positionError);
+    return 0;
+}
+
+static void samplePerPose(const PathProvider& provider, const double start, const double increment,
+        const size_t count, PathSamples& samples) {
+    samples.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const geometry_msgs::PoseStamped pose = provider.poseAtTime(ros::Duration(start + i * increment));
+        samples.x[i] = pose.pose.position.x;
+        samples.y[i] = pose.pose.position.y;
+        samples.yaw[i] = tf::getYaw(pose.pose.orientation);
+    }
+}
+}
+
+int main(int argc, char** argv) {
+    Arguments args;
+    if (!parseArguments(argc, argv, args)) {
+        return 1;
+    }
+
+    string pathType;
+    int samples;
+    int repeats;
+    int roundTrips;
+    try {
+        pathType = getArgument<string>(args, "path_type", "lissajous");
+        samples = getArgument<int>(args, "samples", SAMPLES_DEFAULT);
+        repeats = getArgument<int>(args, "repeats", REPEATS_DEFAULT);
+        roundTrips = getArgument<int>(args, "round_trips", 0);
+    }
+    catch (const boost::bad_lexical_cast& e) {
+        ROS_ERROR("Invalid argument: %s", e.what());
+        return 1;
+    }
+    if (!checkArgumentsUsed(args)) {
+        return 1;
+    }
+    if (samples <= 0 || repeats <= 0) {
+        ROS_ERROR("samples and repeats must be positive");
+        return 1;
+    }
+    if (roundTrips > 0) {
+        // The arguments are already parsed, so do not let ros::init take them as remappings.
+        int rosArgc = 1;
+        ros::init(rosArgc, argv, "path_sampling_benchmark", ros::init_options::AnonymousName);
+        return benchmarkRoundTrips(roundTrips);
+    }
+    ros::Time::init();
+
+    auto_ptr<PathProvider> provider(createPathProvider(pathType));
+    if (!provider.get()) {
+        ROS_ERROR("Unknown path type %s", pathType.c_str());
+        return 1;
+    }
+    provider->init();
+
+    // Cover the whole walk.
+    const double increment = provider->getMaximumTime().toSec() / samples;
+
+    // Best of the repeats, so a descheduled run does not count.
+    PathSamples perPose;
+    PathSamples batched;
+    double perPoseTime = 0;
+    double batchedTime = 0;
+    for (int i = 0; i < repeats; ++i) {
+        ros::WallTime start = ros::WallTime::now();
+        samplePerPose(*provider, 0.0, increment, samples, perPose);
+        const double perPoseRun = (ros::WallTime::now() - start).toSec();
+
+        start = ros::WallTime::now();
+        provider->samplePoses(0.0, increment, samples, batched);
+        const double batchedRun = (ros::WallTime::now() - start).toSec();
+
+        perPoseTime = i == 0 ? perPoseRun : min(perPoseTime, perPoseRun);
+        batchedTime = i == 0 ? batchedRun : min(batchedTime, batchedRun);
+    }
+
+    double positionError = 0;
+    double yawError = 0;
+    for (int i = 0; i < samples; ++i) {
+        positionError = max(positionError, hypot(perPose.x[i] - batched.x[i], perPose.y[i] - batched.y[i]));
+        yawError = max(yawError, angleError(perPose.yaw[i], batched.yaw[i]));
+    }
+
+    printf("path_type %s samples %d per_pose %f s batched %f s speedup %f position_error %g m yaw_error %g rad\n",
+            pathType.c_str(), samples, perPoseTime, batchedTime, batchedTime > 0 ? perPoseTime / batchedTime : 0.0,
+            positionError, yawError);
+    return 0;
+}
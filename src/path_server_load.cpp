@@ -0,0 +1,209 @@
+#include <ros/ros.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
+#include <dogsim/GetPath.h>
+#include <dogsim/GetEntirePath.h>
+#include <dogsim/GetPathPage.h>
+#include "arguments.h"
+
+/**
+ * Load generator for a running get_path_server.
+ *
+ * mode:=entire fetches the whole path with one get_entire_path call. mode:=paged
+ * fetches it page_size poses at a time with get_path_page, as path_visualizer
+ * does. Both print the best latency to the first pose and to the whole path over
+ * the repeats, and the peak resident set of this process. Run each mode in its own
+ * process because the peak only grows. The peak of the server is VmHWM in
+ * /proc/<pid>/status of get_path_server.
+ *
+ * mode:=get_path calls get_path from clients threads, each with its own persistent
+ * connection, for duration seconds of wall time and prints the calls per second.
+ * Restart get_path_server with _threads:=1 to 16 to measure how it scales with
+ * its spinner threads.
+ *
+ * Parameters are passed as name:=value, e.g.
+ * path_server_load mode:=paged increment:=0.01 page_size:=1000
+ * path_server_load mode:=get_path clients:=16 duration:=10
+ */
+namespace {
+using namespace std;
+
+const double INCREMENT_DEFAULT = 0.01;
+const int PAGE_SIZE_DEFAULT = 1000;
+const int REPEATS_DEFAULT = 5;
+const int CLIENTS_DEFAULT = 16;
+const double DURATION_DEFAULT = 10.0;
+
+/**
+ * Latencies of fetching the path once, in seconds.
+ */
+struct Fetch {
+    Fetch() : firstPose(0), total(0), poses(0) {
+    }
+
+    double firstPose;
+    double total;
+    size_t poses;
+};
+
+/**
+ * Peak resident set of this process in MB.
+ */
+static double getPeakRss() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // Linux reports kilobytes.
+    return usage.ru_maxrss / 1024.0;
+}
+
+static bool fetchEntire(ros::ServiceClient& client, const double increment, Fetch& fetch) {
+    const ros::WallTime start = ros::WallTime::now();
+    dogsim::GetEntirePath getPath;
+    getPath.request.increment = increment;
+    if (!client.call(getPath)) {
+        ROS_ERROR("Failed to call get_entire_path");
+        return false;
+    }
+    // Every pose arrives with the one response.
+    fetch.firstPose = fetch.total = (ros::WallTime::now() - start).toSec();
+    fetch.poses = getPath.response.poses.size();
+    return true;
+}
+
+/**
+ * Call get_path until the deadline at times spread over the first minute of the walk.
+ * @param calls Receives the number of calls that succeeded.
+ */
+static void callGetPath(ros::NodeHandle& nh, const ros::WallTime deadline, unsigned long& calls) {
+    ros::ServiceClient client = nh.serviceClient<dogsim::GetPath>("/dogsim/get_path", true);
+    calls = 0;
+    while (ros::WallTime::now() < deadline) {
+        dogsim::GetPath getPath;
+        getPath.request.time = ros::Time((calls % 60000) * 0.001);
+        if (!client.call(getPath)) {
+            ROS_ERROR("Failed to call get_path");
+            return;
+        }
+        ++calls;
+    }
+}
+
+static int measureThroughput(ros::NodeHandle& nh, const int clients, const double duration) {
+    ros::service::waitForService("/dogsim/get_path");
+
+    vector<unsigned long> calls(clients, 0);
+    const ros::WallTime start = ros::WallTime::now();
+    const ros::WallTime deadline = start + ros::WallDuration(duration);
+    boost::thread_group threads;
+    for (int i = 0; i < clients; ++i) {
+        threads.create_thread(boost::bind(&callGetPath, boost::ref(nh), deadline, boost::ref(calls[i])));
+    }
+    threads.join_all();
+    const double elapsed = (ros::WallTime::now() - start).toSec();
+
+    unsigned long total = 0;
+    for (int i = 0; i < clients; ++i) {
+        total += calls[i];
+    }
+    printf("mode get_path clients %d calls %lu duration %f s throughput %f calls/s\n", clients, total, elapsed,
+            elapsed > 0 ? total / elapsed : 0.0);
+    return 0;
+}
+
+static bool fetchPaged(ros::ServiceClient& client, const double increment, const unsigned int pageSize,
+        Fetch& fetch) {
+    const ros::WallTime start = ros::WallTime::now();
+    fetch.poses = 0;
+    unsigned int total = 1;
+    for (unsigned int offset = 0; offset < total; offset += pageSize) {
+        dogsim::GetPathPage getPage;
+        getPage.request.increment = increment;
+        getPage.request.offset = offset;
+        getPage.request.count = pageSize;
+        if (!client.call(getPage)) {
+            ROS_ERROR("Failed to call get_path_page");
+            return false;
+        }
+        if (offset == 0) {
+            fetch.firstPose = (ros::WallTime::now() - start).toSec();
+        }
+        total = getPage.response.total;
+        fetch.poses += getPage.response.poses.size();
+    }
+    fetch.total = (ros::WallTime::now() - start).toSec();
+    return true;
+}
+}
+
+int main(int argc, char** argv) {
+    Arguments args;
+    if (!parseArguments(argc, argv, args)) {
+        return 1;
+    }
+
+    string mode;
+    double increment;
+    int pageSize;
+    int repeats;
+    int clients;
+    double duration;
+    try {
+        mode = getArgument<string>(args, "mode", "entire");
+        increment = getArgument<double>(args, "increment", INCREMENT_DEFAULT);
+        pageSize = getArgument<int>(args, "page_size", PAGE_SIZE_DEFAULT);
+        repeats = getArgument<int>(args, "repeats", REPEATS_DEFAULT);
+        clients = getArgument<int>(args, "clients", CLIENTS_DEFAULT);
+        duration = getArgument<double>(args, "duration", DURATION_DEFAULT);
+    }
+    catch (const boost::bad_lexical_cast& e) {
+        ROS_ERROR("Invalid argument: %s", e.what());
+        return 1;
+    }
+    if (!checkArgumentsUsed(args)) {
+        return 1;
+    }
+    if (increment <= 0 || pageSize <= 0 || repeats <= 0 || clients <= 0 || duration <= 0) {
+        ROS_ERROR("increment, page_size, repeats, clients and duration must be positive");
+        return 1;
+    }
+    if (mode != "entire" && mode != "paged" && mode != "get_path") {
+        ROS_ERROR("Unknown mode %s", mode.c_str());
+        return 1;
+    }
+
+    // The arguments are already parsed, so do not let ros::init take them as remappings.
+    int rosArgc = 1;
+    ros::init(rosArgc, argv, "path_server_load", ros::init_options::AnonymousName);
+    ros::NodeHandle nh;
+    if (mode == "get_path") {
+        return measureThroughput(nh, clients, duration);
+    }
+
+    const string service = mode == "entire" ? "/dogsim/get_entire_path" : "/dogsim/get_path_page";
+    ros::service::waitForService(service);
+    ros::ServiceClient client = mode == "entire" ? nh.serviceClient<dogsim::GetEntirePath>(service, true)
+            : nh.serviceClient<dogsim::GetPathPage>(service, true);
+
+    // Best of the repeats, so a descheduled run does not count.
+    Fetch best;
+    for (int i = 0; i < repeats; ++i) {
+        Fetch fetch;
+        const bool fetched = mode == "entire" ? fetchEntire(client, increment, fetch)
+                : fetchPaged(client, increment, pageSize, fetch);
+        if (!fetched) {
+            return 1;
+        }
+        best.firstPose = i == 0 ? fetch.firstPose : min(best.firstPose, fetch.firstPose);
+        best.total = i == 0 ? fetch.total : min(best.total, fetch.total);
+        best.poses = fetch.poses;
+    }
+
+    printf("mode %s increment %f poses %lu first_pose %f s total %f s peak_rss %f MB\n", mode.c_str(), increment,
+            best.poses, best.firstPose, best.total, getPeakRss());
+    return 0;
+}
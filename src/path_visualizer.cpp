@@ -1,13 +1,17 @@
 #include <ros/ros.h>
 #include <visualization_msgs/Marker.h>
 #include <dogsim/GetPath.h>
-#include <dogsim/GetEntirePath.h>
+#include <dogsim/GetPathPage.h>
 #include <dogsim/utils.h>
+#include "path_client.h"
 
 namespace {
   using namespace std;
   using namespace dogsim;
 
+  //! Number of poses to fetch per page of the complete path.
+  const unsigned int PAGE_SIZE = 250;
+
 class PathVisualizer {
 private:
   
@@ -32,22 +36,22 @@ private:
   //! Timer to broadcast the entire path
   ros::Timer displayTimerComplete;
   
+  //! Local evaluation of the walk.
+  PathClient pathClient;
+
   //! Cached service client.
-  ros::ServiceClient getPathClient;
-  ros::ServiceClient getEntirePathClient;
+  ros::ServiceClient getPathPageClient;
 public:
   //! ROS node initialization
-  PathVisualizer(): pnh("~"){
+  PathVisualizer(): pnh("~"), pathClient(nh){
     
     // Set up the publisher
     goalPubPerm = nh.advertise<visualization_msgs::Marker>("path/walk_goal_viz_perm", 1);
     goalPubEphem = nh.advertise<visualization_msgs::Marker>("path/walk_goal_viz_ephem", 1);
     goalPubComplete = nh.advertise<visualization_msgs::Marker>("path/walk_goal_viz_complete", 1);
    
-    ros::service::waitForService("/dogsim/get_path");
-    ros::service::waitForService("/dogsim/get_entire_path");
-    getPathClient = nh.serviceClient<GetPath>("/dogsim/get_path", true /* persist */);
-    getEntirePathClient = nh.serviceClient<GetEntirePath>("/dogsim/get_entire_path", true /* persist */);
+    ros::service::waitForService("/dogsim/get_path_page");
+    getPathPageClient = nh.serviceClient<GetPathPage>("/dogsim/get_path_page", true /* persist */);
             
     displayTimer = nh.createTimer(ros::Duration(0.1), &PathVisualizer::displayCallback, this);
     displayTimerComplete = nh.createTimer(ros::Duration(1.0), &PathVisualizer::displayCompleteCallback, this);
@@ -55,12 +59,11 @@ public:
 
   geometry_msgs::PointStamped getDogGoalPosition(const ros::Time& time, bool& started, bool& ended){
       // Determine the goal.
-      GetPath getPath;
-      getPath.request.time = time;
-      getPathClient.call(getPath);
-      started = getPath.response.started;
-      ended = getPath.response.ended;
-      return getPath.response.point;
+      GetPath::Response path;
+      pathClient.getPath(time, path);
+      started = path.started;
+      ended = path.ended;
+      return path.point;
   }
   
   void displayFullPath(){
@@ -79,13 +82,21 @@ public:
             marker.scale.y = 0.15;
             marker.scale.z = 0.01;
             
-            GetEntirePath getPath;
-            getPath.request.increment = 0.5;
-            getEntirePathClient.call(getPath);
-            
-            for(size_t i = 0; i < getPath.response.poses.size(); ++i){
-                marker.points.push_back(getPath.response.poses[i].pose.position);
-            }
+            // Fetch the path a page at a time so no single response holds all of it.
+            GetPathPage getPage;
+            getPage.request.increment = 0.5;
+            getPage.request.offset = 0;
+            getPage.request.count = PAGE_SIZE;
+            do {
+                if(!getPathPageClient.call(getPage)){
+                    ROS_WARN("Failed to fetch the complete path");
+                    return;
+                }
+                for(size_t i = 0; i < getPage.response.poses.size(); ++i){
+                    marker.points.push_back(getPage.response.poses[i].pose.position);
+                }
+                getPage.request.offset += PAGE_SIZE;
+            } while(getPage.request.offset < getPage.response.total);
             goalPubComplete.publish(marker);  
         }
   }
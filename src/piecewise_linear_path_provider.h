@@ -3,6 +3,7 @@
 #include "path_provider.h"
 #include <boost/math/constants/constants.hpp>
 #include <vector>
+#include <algorithm>
 #include <tf2/LinearMath/btVector3.h>
 
 namespace {
@@ -16,82 +17,179 @@ namespace {
   
   class PiecewiseLinearPathProvider : public PathProvider {
       public:
-        PiecewiseLinearPathProvider(){
+        PiecewiseLinearPathProvider(const double _roundingDistance = ROUNDING_DISTANCE,
+                const double _velocity = VELOCITY) : roundingDistance(_roundingDistance), velocity(_velocity) {
         }
         
         virtual ~PiecewiseLinearPathProvider(){}
 
         virtual void init(){
             segments = getSegments();
+            buildSegmentIndex();
             calculateTotalLength();
         }
     
         virtual ros::Duration getMaximumTime() const {
             return ros::Duration(totalDuration);
         }
+
+        virtual void describe(dogsim::PathDescription& description) const {
+            description.segmentDirections.resize(segments.size());
+            description.segmentLengths.resize(segments.size());
+            for(unsigned int i = 0; i < segments.size(); ++i){
+                description.segmentDirections[i].x = segments[i].x();
+                description.segmentDirections[i].y = segments[i].y();
+                description.segmentDirections[i].z = segments[i].z();
+                description.segmentLengths[i] = segments[i].w();
+            }
+            description.roundingDistance = roundingDistance;
+            description.velocity = velocity;
+        }
         
-      protected:
         virtual geometry_msgs::Point positionAtTime(const ros::Duration t) const {
-            geometry_msgs::Point goal;
-            
             if(t.toSec() < 0){
-                return goal;
+                return geometry_msgs::Point();
             }
             
-            double distance = VELOCITY * t.toSec();
+            const double distance = velocity * t.toSec();
+            return positionAtDistance(distance, segmentAtDistance(distance));
+        }
+
+        virtual void positionsAtTimes(const double start, const double increment, const size_t count,
+                double* x, double* y) const {
+            walkSamples(start, increment, count, x, y, NULL);
+        }
+
+        virtual double headingAtTime(const ros::Duration t) const {
+            // Before the start the path faces along the first segment.
+            const double distance = max(velocity * t.toSec(), 0.0);
+            btVector3 tangent;
+            positionAtDistance(distance, segmentAtDistance(distance), &tangent);
+            return tfAtan2(tangent.y(), tangent.x());
+        }
+
+        virtual void headingsAtTimes(const double start, const double increment, const size_t count,
+                const double* /* x */, const double* /* y */, double* yaw) const {
+            walkSamples(start, increment, count, NULL, NULL, yaw);
+        }
+        
+    protected:
+    
+        virtual vector<btVector3> getSegments() const = 0;
+
+        /**
+         * Find the first segment that ends at or past the distance.
+         * @return The segment index, or the number of segments if the distance is past
+         *         the end of the path.
+         */
+        unsigned int segmentAtDistance(const double distance) const {
+            const vector<double>::const_iterator segmentEnd = lower_bound(
+                    segmentStartDistances.begin() + 1, segmentStartDistances.end(), distance);
+            return segmentEnd - segmentStartDistances.begin() - 1;
+        }
+
+        /**
+         * Walk count evenly spaced times in order, writing the positions and headings
+         * into any of x, y and yaw that are not NULL.
+         */
+        void walkSamples(const double start, const double increment, const size_t count,
+                double* x, double* y, double* yaw) const {
+            // While times increase the current segment only ever moves forward. Otherwise
+            // each sample searches for its segment.
+            const bool forward = increment >= 0;
+            unsigned int segment = 0;
+            for(size_t j = 0; j < count; ++j){
+                const double t = start + j * increment;
+                const double distance = max(velocity * t, 0.0);
+                if(!forward){
+                    segment = segmentAtDistance(distance);
+                }
+                while(segment < segments.size() && segmentStartDistances[segment + 1] < distance){
+                    ++segment;
+                }
+
+                btVector3 tangent;
+                geometry_msgs::Point position = positionAtDistance(distance, segment, &tangent);
+                if(t < 0){
+                    position = geometry_msgs::Point();
+                }
+                if(x != NULL){
+                    x[j] = position.x;
+                    y[j] = position.y;
+                }
+                if(yaw != NULL){
+                    yaw[j] = tfAtan2(tangent.y(), tangent.x());
+                }
+            }
+        }
+
+        /**
+         * Calculate the position at a distance along the path.
+         * @param distance Distance travelled along the path.
+         * @param i Index of the first segment that ends at or past the distance, or the number
+         *          of segments if the distance is past the end of the path.
+         * @param tangent If not NULL, set to the direction of travel at the distance.
+         */
+        geometry_msgs::Point positionAtDistance(double distance, const unsigned int i,
+                btVector3* tangent = NULL) const {
             btVector3 result = btVector3(0, 0, 0);
             bool roundingRequired = false;
             bool firstRoundingSegment = false;
             unsigned int lastSegmentNumber = 0;
-            for(unsigned int i = 0; i < segments.size(); ++i){
-              // If the point is past the segment, add the whole segment.
-              if(distance > segments[i].w()){
-                result += segments[i] * segments[i].w();
-                distance -= segments[i].w();
-              }
-              // Otherwise add only the correct piece.
-              else {
+
+            // Past the end of the path.
+            if(i == segments.size()){
+                result = segmentStartPoints.back();
+                if(tangent != NULL){
+                    *tangent = segments.back();
+                }
+            }
+            else {
+                result = segmentStartPoints[i];
+                if(tangent != NULL){
+                    *tangent = segments[i];
+                }
+                distance -= segmentStartDistances[i];
+
                 // Determine if rounding will be required.
-                if(segments[i].w() - distance < ROUNDING_DISTANCE && i != segments.size() - 1){
+                if(segments[i].w() - distance < roundingDistance && i != segments.size() - 1){
                     // Only add the distance up to the point where rounding will begin
-                    result += segments[i] * btScalar(segments[i].w() - ROUNDING_DISTANCE);
+                    result += segments[i] * btScalar(segments[i].w() - roundingDistance);
                     roundingRequired = true;
                     lastSegmentNumber = i;
                     firstRoundingSegment = true;
                 }
                 // Beginning of rounded segment
-                else if(distance < ROUNDING_DISTANCE && i != 0){
-                    result += segments[i] * btScalar(ROUNDING_DISTANCE);
+                else if(distance < roundingDistance && i != 0){
+                    result += segments[i] * btScalar(roundingDistance);
                     roundingRequired = true;
                     lastSegmentNumber = i;
                 }
                 else {
                     result += segments[i] * btScalar(distance);
                 }
-                break;
-              }
             }
 
             if(roundingRequired){
                 // Find the center point.
                 btVector3 center;
                 if(firstRoundingSegment){
-                    center = result + segments[lastSegmentNumber + 1] * btScalar(ROUNDING_DISTANCE);
+                    center = result + segments[lastSegmentNumber + 1] * btScalar(roundingDistance);
                 }
                 else {
-                    center = result + segments[lastSegmentNumber - 1] * -1 * btScalar(ROUNDING_DISTANCE);
+                    center = result + segments[lastSegmentNumber - 1] * -1 * btScalar(roundingDistance);
                 }
                 double a;
                 double ratio;
                 btVector3 segment1, segment2;
                 if(firstRoundingSegment){
-                    ratio = 1 - (segments[lastSegmentNumber].w() - distance) / ROUNDING_DISTANCE;
+                    ratio = 1 - (segments[lastSegmentNumber].w() - distance) / roundingDistance;
                     a = ratio * pi / 4.0;
                     segment1 = segments[lastSegmentNumber];
                     segment2 = segments[lastSegmentNumber + 1];
                 }
                 else {
-                    ratio = distance / ROUNDING_DISTANCE;
+                    ratio = distance / roundingDistance;
                     a = ratio * pi / 4.0 + pi / 4.0;
                     segment1 = segments[lastSegmentNumber - 1];
                     segment2 = segments[lastSegmentNumber];
@@ -128,34 +226,56 @@ namespace {
                 
                 // Now add the circular radius
 
-                btVector3 rounding(center.x() + ROUNDING_DISTANCE * cos(a), center.y() + ROUNDING_DISTANCE * -sin(a), 0);
+                btVector3 rounding(center.x() + roundingDistance * cos(a), center.y() + roundingDistance * -sin(a), 0);
                 result = rounding;
+
+                // Derivative of the arc. The angle increases with distance when clockwise.
+                if(tangent != NULL){
+                    *tangent = btVector3(-sin(a), -cos(a), 0) * btScalar(clockwise ? 1 : -1);
+                }
             }
             
 
+            geometry_msgs::Point goal;
             goal.x = result.x() + 1.0; // Offset the start position
             goal.y = result.y();
             goal.z = 0;
             return goal;
         }
         
-    protected:
-    
-        virtual vector<btVector3> getSegments() const = 0;
-        
-        void calculateTotalLength(){
-            // Calculate the total length
-            double totalLength = 0;
+        /**
+         * Build the cumulative distance and start point of every segment so
+         * positionAtTime can binary search rather than walk the segments.
+         * Both tables hold one extra entry for the end of the path.
+         */
+        void buildSegmentIndex(){
+            segmentStartDistances.assign(1, 0.0);
+            segmentStartPoints.assign(1, btVector3(0, 0, 0));
             for(unsigned int i = 0; i < segments.size(); ++i){
-              totalLength += segments[i].w();
+              segmentStartDistances.push_back(segmentStartDistances.back() + segments[i].w());
+              segmentStartPoints.push_back(segmentStartPoints.back() + segments[i] * segments[i].w());
             }
+        }
 
-            totalDuration = totalLength / VELOCITY;
+        void calculateTotalLength(){
+            totalDuration = segmentStartDistances.back() / velocity;
         }
         
      private:
+        //! Distance before and after each corner that is rounded.
+        const double roundingDistance;
+
+        //! Walking velocity in m/s
+        const double velocity;
+
         double totalDuration;
         
         vector<btVector3> segments;
+
+        //! Distance along the path at which each segment starts.
+        vector<double> segmentStartDistances;
+
+        //! Position at which each segment starts.
+        vector<btVector3> segmentStartPoints;
   };
 }
@@ -1,3 +1,4 @@
+#pragma once
 #include "path_provider.h"
 #include "piecewise_linear_path_provider.h"
 #include <vector>
@@ -9,6 +10,10 @@ namespace {
       public:
           RandomWalkPathProvider(){}
           virtual ~RandomWalkPathProvider(){}
+          virtual void describe(dogsim::PathDescription& description) const {
+              PiecewiseLinearPathProvider::describe(description);
+              description.pathType = "randomwalk";
+          }
       protected:
         virtual std::vector<btVector3> getSegments() const {
             std::vector<btVector3> segments(16);
@@ -0,0 +1,251 @@
+#include <ros/ros.h>
+#include <limits>
+#include <tf/transform_datatypes.h>
+#include <sensor_msgs/JointState.h>
+#include <dogsim/LeashInfoArray.h>
+#include <dogsim/DogPosition.h>
+#include <dogsim/PathViewInfo.h>
+#include <dogsim/GetPath.h>
+#include <position_tracker/StartMeasurement.h>
+#include <position_tracker/StopMeasurement.h>
+#include "path_client.h"
+#include "run_recording.h"
+#include "walk_streams.h"
+
+namespace {
+using namespace std;
+using namespace ros;
+
+//! Default wall time between writes of the partly filled chunks, in seconds.
+const double FLUSH_PERIOD_DEFAULT = 2.0;
+
+//! Recorded when a model or the goal is not known.
+const float MISSING = numeric_limits<float>::quiet_NaN();
+
+static vector<string> makeColumns(const char* columns[], const unsigned int count) {
+    return vector<string>(columns, columns + count);
+}
+
+/**
+ * Records the walk to a columnar recording for offline scoring. See run_recording.h
+ * for the format. Streams, each stamped with its message time:
+ *  - measurement: started is 1 at start_measuring and 0 at stop_measuring.
+ *  - leash: each leash sample.
+ *  - dog_position: each estimate with its latency.
+ *  - path_view: each path visibility ratio.
+ *  - joint_effort: the effort of each joint.
+ *  - ground_truth: the dog, the robot base and the dog's goal at the stamp of each
+ *    ground truth message, at most every pose_period seconds. Built from the model
+ *    states while the dog model plugin publishes none, as in the solo robot scenarios.
+ */
+class Recorder {
+private:
+    NodeHandle nh;
+    NodeHandle pnh;
+
+    RecordingWriter writer;
+    string fileName;
+
+    unsigned int measurementStream;
+    unsigned int leashStream;
+    unsigned int dogPositionStream;
+    unsigned int pathViewStream;
+    unsigned int groundTruthStream;
+
+    //! Joints are only known from the first joint state.
+    bool hasJointStream;
+    unsigned int jointStream;
+    vector<string> jointNames;
+
+    //! Minimum sim time between ground truth records.
+    double posePeriod;
+    Time lastPoseTime;
+    unsigned long groundTruthRecords;
+
+    //! Ground truth while the dog model plugin publishes none.
+    ModelStatesGroundTruth modelStatesGroundTruth;
+
+    PathClient pathClient;
+
+    Subscriber startMeasuringSub;
+    Subscriber stopMeasuringSub;
+    Subscriber leashSub;
+    Subscriber dogPositionSub;
+    Subscriber pathViewSub;
+    Subscriber jointStateSub;
+    Subscriber groundTruthSub;
+    Subscriber modelStatesSub;
+    WallTimer flushTimer;
+
+public:
+    Recorder() :
+            pnh("~"), writer(getChunkSize()), hasJointStream(false), jointStream(0), groundTruthRecords(0),
+            modelStatesGroundTruth(getModelName()), pathClient(nh) {
+        pnh.param<string>("file", fileName, "walk.rec");
+        pnh.param<double>("pose_period", posePeriod, 0.0);
+        double flushPeriod;
+        pnh.param<double>("flush_period", flushPeriod, FLUSH_PERIOD_DEFAULT);
+
+        if (!writer.open(fileName)) {
+            ROS_ERROR("Failed to create the recording %s", fileName.c_str());
+            return;
+        }
+
+        const char* measurementColumns[] = { "started" };
+        measurementStream = writer.addStream("measurement", makeColumns(measurementColumns, 1));
+        const char* leashColumns[] = { "force_x", "force_y", "force_z", "ratio", "distance" };
+        leashStream = writer.addStream("leash", makeColumns(leashColumns, 5));
+        const char* dogPositionColumns[] = { "x", "y", "unknown", "stale", "latency" };
+        dogPositionStream = writer.addStream("dog_position", makeColumns(dogPositionColumns, 5));
+        const char* pathViewColumns[] = { "visibility_ratio" };
+        pathViewStream = writer.addStream("path_view", makeColumns(pathViewColumns, 1));
+        const char* groundTruthColumns[] = { "dog_x", "dog_y", "dog_z", "robot_x", "robot_y", "robot_yaw", "goal_x",
+                "goal_y", "goal_z", "walking" };
+        groundTruthStream = writer.addStream("ground_truth", makeColumns(groundTruthColumns, 10));
+
+        startMeasuringSub = nh.subscribe("start_measuring", 1, &Recorder::startMeasuring, this);
+        stopMeasuringSub = nh.subscribe("stop_measuring", 1, &Recorder::stopMeasuring, this);
+        leashSub = nh.subscribe(LEASH_TOPIC, STREAM_QUEUE_SIZE, &Recorder::leashCallback, this);
+        dogPositionSub = nh.subscribe(DOG_POSITION_TOPIC, STREAM_QUEUE_SIZE, &Recorder::dogPositionCallback, this);
+        pathViewSub = nh.subscribe(PATH_VIEW_TOPIC, STREAM_QUEUE_SIZE, &Recorder::pathViewCallback, this);
+        jointStateSub = nh.subscribe(JOINT_STATES_TOPIC, STREAM_QUEUE_SIZE, &Recorder::jointStateCallback, this);
+        groundTruthSub = nh.subscribe(GROUND_TRUTH_TOPIC, GROUND_TRUTH_QUEUE_SIZE, &Recorder::groundTruthCallback,
+                this, TransportHints().tcpNoDelay());
+        modelStatesSub = nh.subscribe(MODEL_STATES_TOPIC, GROUND_TRUTH_QUEUE_SIZE, &Recorder::modelStatesCallback,
+                this, TransportHints().tcpNoDelay());
+
+        // Push partly filled chunks out so a crash loses little.
+        flushTimer = nh.createWallTimer(WallDuration(flushPeriod), &Recorder::flush, this);
+        ROS_INFO("Recording to %s", fileName.c_str());
+    }
+
+    ~Recorder() {
+        if (!writer.isOpen()) {
+            return;
+        }
+        writer.close();
+        if (writer.hasFailed()) {
+            ROS_ERROR("Failed to write the recording %s", fileName.c_str());
+        }
+        if (writer.getDroppedChunks() > 0) {
+            ROS_ERROR("Dropped %lu chunks because the disk could not keep up", writer.getDroppedChunks());
+        }
+        if (groundTruthRecords == 0) {
+            ROS_WARN("Recorded no ground truth, so %s has no poses to score", fileName.c_str());
+        }
+        ROS_INFO("Recorded %lu records in %lu bytes to %s", writer.getRecordCount(),
+                static_cast<unsigned long>(writer.getSize()), fileName.c_str());
+    }
+
+private:
+    static unsigned int getChunkSize() {
+        NodeHandle pnh("~");
+        int chunkSize;
+        pnh.param<int>("chunk_size", chunkSize, RECORDING_CHUNK_SIZE_DEFAULT);
+        return max(chunkSize, 1);
+    }
+
+    static string getModelName() {
+        NodeHandle pnh("~");
+        string modelName;
+        pnh.param<string>("model_name", modelName, "dog");
+        return modelName;
+    }
+
+    void flush(const WallTimerEvent& /*event*/) {
+        writer.flush();
+    }
+
+    void startMeasuring(const position_tracker::StartMeasurementConstPtr& msg) {
+        const float started = 1;
+        writer.append(measurementStream, msg->header.stamp.toSec(), &started);
+    }
+
+    void stopMeasuring(const position_tracker::StopMeasurementConstPtr& msg) {
+        const float started = 0;
+        writer.append(measurementStream, msg->header.stamp.toSec(), &started);
+    }
+
+    void leashCallback(const dogsim::LeashInfoArrayConstPtr& batch) {
+        for (unsigned int i = 0; i < batch->samples.size(); ++i) {
+            const dogsim::LeashInfo& sample = batch->samples[i];
+            const float values[] = { sample.force.x, sample.force.y, sample.force.z, sample.ratio, sample.distance };
+            writer.append(leashStream, sample.header.stamp.toSec(), values);
+        }
+    }
+
+    void dogPositionCallback(const dogsim::DogPositionConstPtr& position) {
+        const double stamp = position->header.stamp.toSec();
+        const float values[] = { position->pose.pose.position.x, position->pose.pose.position.y, position->unknown,
+                position->stale, Time::now().toSec() - stamp };
+        writer.append(dogPositionStream, stamp, values);
+    }
+
+    void pathViewCallback(const dogsim::PathViewInfoConstPtr& view) {
+        writer.append(pathViewStream, view->header.stamp.toSec(), &view->visibilityRatio);
+    }
+
+    void jointStateCallback(const sensor_msgs::JointStateConstPtr& jointState) {
+        if (!hasJointStream) {
+            jointNames = jointState->name;
+            jointStream = writer.addStream("joint_effort", jointNames);
+            hasJointStream = true;
+        }
+        if (jointState->name != jointNames || jointState->effort.size() != jointNames.size()) {
+            ROS_WARN_THROTTLE(1.0, "Skipping a joint state with different joints");
+            return;
+        }
+
+        vector<float> effort(jointState->effort.begin(), jointState->effort.end());
+        writer.append(jointStream, jointState->header.stamp.toSec(), effort.empty() ? NULL : &effort[0]);
+    }
+
+    void groundTruthCallback(const dogsim::GroundTruthConstPtr& truth) {
+        modelStatesGroundTruth.onGroundTruth(*truth);
+        recordGroundTruth(*truth);
+    }
+
+    void modelStatesCallback(const gazebo_msgs::ModelStatesConstPtr& states) {
+        dogsim::GroundTruth truth;
+        if (modelStatesGroundTruth.convert(*states, truth)) {
+            recordGroundTruth(truth);
+        }
+    }
+
+    void recordGroundTruth(const dogsim::GroundTruth& truth) {
+        const Time& stamp = truth.header.stamp;
+        if (!lastPoseTime.isZero() && (stamp - lastPoseTime).toSec() < posePeriod) {
+            return;
+        }
+        lastPoseTime = stamp;
+
+        float values[] = { MISSING, MISSING, MISSING, MISSING, MISSING, MISSING, MISSING, MISSING, MISSING, 0 };
+        if (truth.hasDog) {
+            values[0] = truth.dog.position.x;
+            values[1] = truth.dog.position.y;
+            values[2] = truth.dog.position.z;
+        }
+        if (truth.hasRobot) {
+            values[3] = truth.robot.position.x;
+            values[4] = truth.robot.position.y;
+            values[5] = tf::getYaw(truth.robot.orientation);
+        }
+        dogsim::GetPath::Response path;
+        if (pathClient.getPath(stamp, path)) {
+            values[6] = path.point.point.x;
+            values[7] = path.point.point.y;
+            values[8] = path.point.point.z;
+            values[9] = path.started && !path.ended;
+        }
+        writer.append(groundTruthStream, stamp.toSec(), values);
+        ++groundTruthRecords;
+    }
+};
+}
+
+int main(int argc, char **argv) {
+    ros::init(argc, argv, "recorder");
+    Recorder recorder;
+    ros::spin();
+    return 0;
+}
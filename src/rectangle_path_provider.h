@@ -1,3 +1,4 @@
+#pragma once
 #include "path_provider.h"
 #include "piecewise_linear_path_provider.h"
 #include <vector>
@@ -10,6 +11,10 @@ namespace {
       public:
         RectanglePathProvider(){}
         virtual ~RectanglePathProvider(){}
+        virtual void describe(dogsim::PathDescription& description) const {
+            PiecewiseLinearPathProvider::describe(description);
+            description.pathType = "rectangle";
+        }
     protected:
         virtual vector<btVector3> getSegments() const {
             vector<btVector3> segments(4);
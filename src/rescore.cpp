@@ -0,0 +1,381 @@
+#include <ros/ros.h>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/math/special_functions/fpclassify.hpp>
+#include <dogsim/utils.h>
+#include "arguments.h"
+#include "run_recording.h"
+#include "walk_metrics.h"
+
+namespace {
+using namespace std;
+
+struct Settings {
+    double dogHeight;
+    double leashLength;
+};
+
+struct Score {
+    Score() : scored(false) {
+    }
+
+    bool scored;
+    string error;
+    MetricValues values;
+};
+
+/**
+ * Columns of a recorded stream, looked up by name once.
+ */
+class StreamColumns {
+public:
+    StreamColumns(const Recording& recording, const string& streamName, const char* names[],
+            const unsigned int count) :
+            stream(recording.getStream(streamName)) {
+        for (unsigned int i = 0; i < count && stream; ++i) {
+            const int column = stream->findColumn(names[i]);
+            if (column < 0) {
+                stream = NULL;
+                break;
+            }
+            columns.push_back(column);
+        }
+    }
+
+    const RecordedStream* getStream() const {
+        return stream;
+    }
+
+    unsigned int operator[](const unsigned int i) const {
+        return columns[i];
+    }
+
+private:
+    const RecordedStream* stream;
+    vector<unsigned int> columns;
+};
+
+/**
+ * Scores a recording the way the metrics node scores a live walk: every record
+ * stamped between start_measuring and stop_measuring goes to the same accumulators.
+ * The robot path is not recorded, so robot_path is not scored.
+ */
+class RecordingScorer {
+private:
+    const Settings& settings;
+    Recording recording;
+    double startTime;
+    double stopTime;
+
+public:
+    explicit RecordingScorer(const Settings& _settings) : settings(_settings), startTime(0), stopTime(0) {
+    }
+
+    bool score(const string& fileName, Score& score) {
+        if (!recording.open(fileName)) {
+            score.error = recording.getError();
+            return false;
+        }
+        if (!findMeasurement()) {
+            score.error = "the recording has no start_measuring";
+            return false;
+        }
+
+        scorePath(score.values);
+        scoreLeash(score.values);
+        scoreJointEffort(score.values);
+        scoreDogPosition(score.values);
+        scorePathVisibility(score.values);
+        score.values.push_back(make_pair("sim_time", stopTime - startTime));
+        score.scored = true;
+        return true;
+    }
+
+private:
+    /**
+     * Find the first measurement. A run that crashed before stop_measuring is
+     * scored up to its last record.
+     */
+    bool findMeasurement() {
+        const char* names[] = { "started" };
+        const StreamColumns measurement(recording, "measurement", names, 1);
+        RecordCursor cursor(measurement.getStream());
+        for (; cursor.isValid() && cursor.getValue(measurement[0]) == 0; cursor.next()) {
+        }
+        if (!cursor.isValid()) {
+            return false;
+        }
+        startTime = cursor.getTime();
+
+        for (; cursor.isValid() && cursor.getValue(measurement[0]) != 0; cursor.next()) {
+        }
+        stopTime = cursor.isValid() ? cursor.getTime() : getLastTime();
+        return true;
+    }
+
+    double getLastTime() const {
+        double lastTime = startTime;
+        const vector<RecordedStream>& streams = recording.getStreams();
+        for (unsigned int i = 0; i < streams.size(); ++i) {
+            if (!streams[i].chunks.empty()) {
+                lastTime = max(lastTime, streams[i].chunks.back().lastTime);
+            }
+        }
+        return lastTime;
+    }
+
+    /**
+     * Cursor at the first record of the measurement.
+     */
+    RecordCursor measured(const StreamColumns& columns) const {
+        RecordCursor cursor(columns.getStream());
+        cursor.seek(startTime);
+        return cursor;
+    }
+
+    bool isMeasured(const RecordCursor& cursor) const {
+        return cursor.isValid() && cursor.getTime() <= stopTime;
+    }
+
+    void scorePath(MetricValues& values) const {
+        const char* names[] = { "dog_x", "dog_y", "dog_z", "goal_x", "goal_y", "goal_z", "walking" };
+        const StreamColumns groundTruth(recording, "ground_truth", names, 7);
+        PathDeviationMetric metric(settings.dogHeight);
+        for (RecordCursor cursor = measured(groundTruth); isMeasured(cursor); cursor.next()) {
+            if (cursor.getValue(groundTruth[6]) == 0 || !boost::math::isfinite(cursor.getValue(groundTruth[0]))) {
+                continue;
+            }
+            const double deviation = sqrt(
+                    utils::square(cursor.getValue(groundTruth[3]) - cursor.getValue(groundTruth[0]))
+                            + utils::square(cursor.getValue(groundTruth[4]) - cursor.getValue(groundTruth[1]))
+                            + utils::square(cursor.getValue(groundTruth[5]) - cursor.getValue(groundTruth[2])));
+            metric.add(cursor.getTime(), deviation, cursor.getValue(groundTruth[2]));
+        }
+        metric.getValues(values);
+    }
+
+    void scoreLeash(MetricValues& values) const {
+        const char* names[] = { "force_x", "force_y", "force_z", "distance" };
+        const StreamColumns leash(recording, "leash", names, 4);
+        LeashForceMetric metric(settings.leashLength);
+        for (RecordCursor cursor = measured(leash); isMeasured(cursor); cursor.next()) {
+            const double force = sqrt(utils::square(cursor.getValue(leash[0]))
+                    + utils::square(cursor.getValue(leash[1])) + utils::square(cursor.getValue(leash[2])));
+            metric.add(cursor.getTime(), force, cursor.getValue(leash[3]));
+        }
+        metric.getValues(values);
+    }
+
+    void scoreJointEffort(MetricValues& values) const {
+        const RecordedStream* stream = recording.getStream("joint_effort");
+        JointEffortMetric metric;
+        RecordCursor cursor(stream);
+        cursor.seek(startTime);
+        vector<double> effort(stream ? stream->columnNames.size() : 0);
+        for (; isMeasured(cursor); cursor.next()) {
+            for (unsigned int i = 0; i < effort.size(); ++i) {
+                effort[i] = cursor.getValue(i);
+            }
+            metric.add(cursor.getTime(), effort);
+        }
+        metric.getValues(values);
+    }
+
+    /**
+     * Each estimate is compared with the last dog pose recorded before it arrived,
+     * which is the pose the live node held when the estimate came in.
+     */
+    void scoreDogPosition(MetricValues& values) const {
+        const char* names[] = { "x", "y", "unknown", "latency" };
+        const StreamColumns dogPosition(recording, "dog_position", names, 4);
+        const char* groundTruthNames[] = { "dog_x", "dog_y" };
+        const StreamColumns groundTruth(recording, "ground_truth", groundTruthNames, 2);
+
+        DogTrackingMetric metric;
+        metric.start(startTime);
+        RecordCursor pose(groundTruth.getStream());
+        RecordCursor nextPose(groundTruth.getStream());
+        bool hasPose = false;
+        for (RecordCursor cursor = measured(dogPosition); isMeasured(cursor); cursor.next()) {
+            const double stamp = cursor.getTime();
+            if (cursor.getValue(dogPosition[2]) != 0) {
+                metric.addUnknown(stamp);
+                continue;
+            }
+
+            // Estimates arrive in order, so the pose only moves forward.
+            const double received = stamp + cursor.getValue(dogPosition[3]);
+            for (; nextPose.isValid() && nextPose.getTime() <= received; nextPose.next()) {
+                if (boost::math::isfinite(nextPose.getValue(groundTruth[0]))) {
+                    pose = nextPose;
+                    hasPose = true;
+                }
+            }
+            if (!hasPose) {
+                continue;
+            }
+
+            // Do not include z position because it is not tracked
+            const double deviation = sqrt(
+                    utils::square(pose.getValue(groundTruth[0]) - cursor.getValue(dogPosition[0]))
+                            + utils::square(pose.getValue(groundTruth[1]) - cursor.getValue(dogPosition[1])));
+            metric.addKnown(stamp, deviation, received);
+        }
+        metric.getValues(stopTime, values);
+    }
+
+    void scorePathVisibility(MetricValues& values) const {
+        const char* names[] = { "visibility_ratio" };
+        const StreamColumns pathView(recording, "path_view", names, 1);
+        PathVisibilityMetric metric;
+        metric.start(startTime);
+        for (RecordCursor cursor = measured(pathView); isMeasured(cursor); cursor.next()) {
+            metric.add(cursor.getTime(), cursor.getValue(pathView[0]));
+        }
+        metric.getValues(stopTime, values);
+    }
+};
+
+/**
+ * Scores the recordings on a pool of threads. Each thread takes the next
+ * unscored recording, so a long run does not hold up the others.
+ */
+class RescorePool {
+public:
+    RescorePool(const Settings& _settings, const vector<string>& _files) :
+            settings(_settings), files(_files), scores(_files.size()), nextFile(0) {
+    }
+
+    void run(const unsigned int jobs) {
+        boost::thread_group threads;
+        for (unsigned int i = 0; i < jobs; ++i) {
+            threads.create_thread(boost::bind(&RescorePool::work, this));
+        }
+        threads.join_all();
+    }
+
+    const vector<Score>& getScores() const {
+        return scores;
+    }
+
+private:
+    void work() {
+        while (true) {
+            const size_t i = __sync_fetch_and_add(&nextFile, 1);
+            if (i >= files.size()) {
+                return;
+            }
+            RecordingScorer scorer(settings);
+            scorer.score(files[i], scores[i]);
+        }
+    }
+
+    const Settings& settings;
+    const vector<string>& files;
+    vector<Score> scores;
+    volatile size_t nextFile;
+};
+
+/**
+ * One row per recording. The columns are taken from the first scored recording.
+ */
+static void writeScores(ostream& out, const vector<string>& files, const vector<Score>& scores) {
+    const Score* header = NULL;
+    for (unsigned int i = 0; i < scores.size() && !header; ++i) {
+        if (scores[i].scored) {
+            header = &scores[i];
+        }
+    }
+
+    out << "recording";
+    for (unsigned int j = 0; header && j < header->values.size(); ++j) {
+        out << "," << header->values[j].first;
+    }
+    out << ",error" << endl;
+
+    out << setprecision(10);
+    for (unsigned int i = 0; i < scores.size(); ++i) {
+        out << files[i];
+        for (unsigned int j = 0; header && j < header->values.size(); ++j) {
+            out << ",";
+            if (scores[i].scored) {
+                out << scores[i].values[j].second;
+            }
+        }
+        out << ",";
+        if (!scores[i].error.empty()) {
+            out << "\"" << scores[i].error << "\"";
+        }
+        out << endl;
+    }
+}
+}
+
+/**
+ * Rescores recorded walks offline:
+ *   rescore [jobs:=N] [dog_height:=m] [leash_length:=m] [output:=scores.csv] walk.rec...
+ * Writes one CSV row of metrics per recording to output, or to stdout.
+ */
+int main(int argc, char** argv) {
+    ros::Time::init();
+
+    Arguments args;
+    vector<string> files;
+    parseArguments(argc, argv, args, &files);
+
+    Settings settings;
+    unsigned int jobs;
+    string output;
+    try {
+        settings.dogHeight = getArgument<double>(args, "dog_height", DOG_HEIGHT_DEFAULT);
+        settings.leashLength = getArgument<double>(args, "leash_length", LEASH_LENGTH_DEFAULT);
+        jobs = getArgument<unsigned int>(args, "jobs", boost::thread::hardware_concurrency());
+        output = getArgument<string>(args, "output", "");
+    }
+    catch (const boost::bad_lexical_cast& e) {
+        ROS_ERROR("Invalid argument: %s", e.what());
+        return 1;
+    }
+    if (!checkArgumentsUsed(args)) {
+        return 1;
+    }
+    if (files.empty()) {
+        ROS_ERROR("No recordings to score");
+        return 1;
+    }
+    jobs = max(1u, min(jobs, static_cast<unsigned int>(files.size())));
+
+    const ros::WallTime startTime = ros::WallTime::now();
+    RescorePool pool(settings, files);
+    pool.run(jobs);
+    const double wallTime = (ros::WallTime::now() - startTime).toSec();
+
+    const vector<Score>& scores = pool.getScores();
+    unsigned int failed = 0;
+    for (unsigned int i = 0; i < scores.size(); ++i) {
+        if (!scores[i].scored) {
+            ROS_ERROR("Failed to score %s: %s", files[i].c_str(), scores[i].error.c_str());
+            ++failed;
+        }
+    }
+
+    if (output.empty()) {
+        writeScores(cout, files, scores);
+    }
+    else {
+        ofstream out(output.c_str());
+        writeScores(out, files, scores);
+        if (!out) {
+            ROS_ERROR("Failed to write %s", output.c_str());
+            return 1;
+        }
+    }
+    ROS_INFO("Scored %lu recordings on %u threads in %f s of wall time", files.size() - failed, jobs, wallTime);
+    return failed > 0 ? 1 : 0;
+}
@@ -12,6 +12,7 @@
 #include <dogsim/MoveDogAwayAction.h>
 #include <actionlib/client/simple_action_client.h>
 #include <dogsim/ControlDogPositionAction.h>
+#include "lockstep_client.h"
 
 namespace {
 using namespace std;
@@ -67,6 +68,9 @@ private:
     ros::Publisher startMeasuringPub;
     ros::Publisher stopMeasuringPub;
 
+    //! Holds the world until the queued callbacks have run when in lockstep.
+    LockstepClient lockstep;
+
     void publishStopMeasurement() {
         // Notify clients to stop measuring.
         position_tracker::StopMeasurement stopMeasuringMsg;
@@ -82,7 +86,7 @@ public:
                     "move_arm_to_base_position_action", true),
                     controlDogPositionBehaviorClient("control_dog_position_behavior", true),
                     soloMode(false), noSteeringMode(
-                    false), avoidingDog(false) {
+                    false), avoidingDog(false), lockstep("robot_driver") {
 
         ROS_INFO("Initializing the robot driver @ %f", ros::Time::now().toSec());
 
@@ -116,6 +120,7 @@ public:
 
         pnh.param<bool>("no_steering_mode", noSteeringMode, false);
         init();
+        lockstep.acknowledgeFromQueue(nh);
     }
 
     void init() {
@@ -0,0 +1,46 @@
+#pragma once
+#include <cmath>
+#include <geometry_msgs/PoseStamped.h>
+#include <tf/transform_listener.h>
+#include <tf2/LinearMath/btVector3.h>
+#include <boost/math/constants/constants.hpp>
+
+namespace {
+
+  const double TRAILING_DISTANCE = 0;
+
+  //! Shift distance from base to desired arm position
+  //! Calculated as the negative of /base_footprint to /r_wrist_roll_link in x axis
+  const double SHIFT_DISTANCE = 0.6;
+
+  /**
+   * Calculate the robot pose beside the dog at the given dog position and heading.
+   */
+  static geometry_msgs::PoseStamped getPlannedRobotPose(const double dogX, const double dogY, const double dogYaw) {
+
+      // Calculate the vector of the tangent line.
+      btVector3 tangent = btVector3(cos(dogYaw), sin(dogYaw), 0);
+
+      // Now select a point on the vector but slightly behind.
+      btVector3 backGoal = btVector3(dogX, dogY, 0)
+      - tangent * tfScalar(TRAILING_DISTANCE);
+
+      // Rotate the vector to perpendicular
+      btVector3 perp = tangent.rotate(btVector3(0, 0, 1),
+              tfScalar(boost::math::constants::pi<double>() / 2.0));
+
+      // Select a point on the perpendicular line.
+      btVector3 finalGoal = backGoal + perp * tfScalar(SHIFT_DISTANCE);
+
+      geometry_msgs::PoseStamped robotGoal;
+      robotGoal.pose.position.x = finalGoal.x();
+      robotGoal.pose.position.y = finalGoal.y();
+      robotGoal.pose.position.z = finalGoal.z();
+      robotGoal.header.frame_id = "/map";
+
+      // Calculate the yaw so we can create an orientation.
+      robotGoal.pose.orientation = tf::createQuaternionMsgFromYaw(dogYaw);
+
+      return robotGoal;
+  }
+}
@@ -0,0 +1,729 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <boost/thread/thread.hpp>
+#include "single_producer_ring.h"
+
+/**
+ * Columnar recording of a run. Written append only by RecordingWriter and read
+ * through a memory map by Recording, without ROS.
+ *
+ * All values are little endian and every block starts on an 8 byte boundary.
+ *
+ * File header: char[8] "DOGREC01", uint32 version, uint32 reserved.
+ *
+ * Then blocks, each uint32 type and uint32 payload size (padded to 8) followed by
+ * the payload:
+ *  - Stream (1): uint32 stream id, uint32 column count, the stream name and each
+ *    column name NUL terminated. Precedes the chunks of the stream.
+ *  - Chunk (2): uint32 stream id, uint32 record count, float64 first and last time,
+ *    the float64 time column, then a float32 column per stream column.
+ *  - Index (3): uint32 entry count, uint32 reserved, then per block in file order
+ *    uint64 offset, uint32 type, uint32 stream id, uint32 record count, uint32
+ *    reserved, float64 first and last time.
+ *
+ * A closed recording ends with the index block and a trailer of uint64 index
+ * offset and char[8] "DOGRECIX". A recording that was not closed has neither, and
+ * is read by walking the blocks from the start.
+ */
+namespace {
+
+  const char RECORDING_MAGIC[] = "DOGREC01";
+  const char RECORDING_INDEX_MAGIC[] = "DOGRECIX";
+  const uint32_t RECORDING_VERSION = 1;
+  const size_t RECORDING_HEADER_SIZE = 16;
+  const size_t RECORDING_TRAILER_SIZE = 16;
+  const size_t RECORDING_BLOCK_HEADER_SIZE = 8;
+  const size_t RECORDING_CHUNK_HEADER_SIZE = 24;
+  const size_t RECORDING_INDEX_ENTRY_SIZE = 40;
+
+  enum RecordingBlockType {
+    RECORDING_STREAM_BLOCK = 1,
+    RECORDING_CHUNK_BLOCK = 2,
+    RECORDING_INDEX_BLOCK = 3
+  };
+
+  //! Default number of records buffered per stream before a chunk is written.
+  const unsigned int RECORDING_CHUNK_SIZE_DEFAULT = 1024;
+
+  //! Blocks waiting for the flusher. Chunks are dropped rather than block the recorder when full.
+  const size_t RECORDING_QUEUE_CAPACITY = 256;
+
+  //! Time between writes of the flusher thread, in milliseconds.
+  const long RECORDING_FLUSH_MS = 100;
+
+  /**
+   * Location of a block, as written to the index.
+   */
+  struct RecordingIndexEntry {
+    uint64_t offset;
+    uint32_t type;
+    uint32_t stream;
+    uint32_t count;
+    double firstTime;
+    double lastTime;
+  };
+
+  /**
+   * Writes a recording. Records are buffered per stream on the calling thread and
+   * written as chunks by a flusher thread, so appending never waits for the disk.
+   * All methods must be called from one thread.
+   */
+  class RecordingWriter {
+    public:
+      explicit RecordingWriter(const unsigned int _chunkSize = RECORDING_CHUNK_SIZE_DEFAULT) :
+          chunkSize(std::max(1u, _chunkSize)), file(NULL), failed(false), position(0), ring(RECORDING_QUEUE_CAPACITY),
+          droppedChunks(0), recordCount(0) {
+      }
+
+      ~RecordingWriter() {
+          close();
+      }
+
+      /**
+       * Create the file and start the flusher.
+       * @return False if the file could not be created.
+       */
+      bool open(const std::string& fileName) {
+          file = fopen(fileName.c_str(), "wb");
+          if (!file) {
+              return false;
+          }
+
+          std::vector<char> header(RECORDING_HEADER_SIZE, 0);
+          memcpy(&header[0], RECORDING_MAGIC, 8);
+          put<uint32_t>(header, 8, RECORDING_VERSION);
+          write(header);
+
+          flushThread = boost::thread(&RecordingWriter::flushLoop, this);
+          return !failed;
+      }
+
+      bool isOpen() const {
+          return file != NULL;
+      }
+
+      /**
+       * Define a stream. Records of the stream have one value per column.
+       * @return The stream id to append with.
+       */
+      unsigned int addStream(const std::string& name, const std::vector<std::string>& columns) {
+          const unsigned int id = streams.size();
+          streams.push_back(StreamBuffer(columns.size()));
+
+          std::vector<char> block(RECORDING_BLOCK_HEADER_SIZE + 8);
+          put<uint32_t>(block, RECORDING_BLOCK_HEADER_SIZE, id);
+          put<uint32_t>(block, RECORDING_BLOCK_HEADER_SIZE + 4, columns.size());
+          block.insert(block.end(), name.begin(), name.end());
+          block.push_back('\0');
+          for (unsigned int i = 0; i < columns.size(); ++i) {
+              block.insert(block.end(), columns[i].begin(), columns[i].end());
+              block.push_back('\0');
+          }
+          finishBlock(block, RECORDING_STREAM_BLOCK);
+
+          // The chunks of the stream cannot be read without its definition, so wait for room.
+          PendingBlock pending(block, RECORDING_STREAM_BLOCK, id, 0, 0, 0);
+          while (!ring.push(pending)) {
+              boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+          }
+          return id;
+      }
+
+      /**
+       * Append a record with one value per column of the stream.
+       */
+      void append(const unsigned int stream, const double time, const float* values) {
+          StreamBuffer& buffer = streams[stream];
+          buffer.time.push_back(time);
+          for (unsigned int i = 0; i < buffer.columns.size(); ++i) {
+              buffer.columns[i].push_back(values[i]);
+          }
+          ++recordCount;
+          if (buffer.time.size() >= chunkSize) {
+              queueChunk(stream);
+          }
+      }
+
+      /**
+       * Queue the partly filled chunks so they reach the disk.
+       */
+      void flush() {
+          for (unsigned int i = 0; i < streams.size(); ++i) {
+              queueChunk(i);
+          }
+      }
+
+      /**
+       * Write everything buffered, then the index, and close the file.
+       */
+      void close() {
+          if (!file) {
+              return;
+          }
+          flush();
+          flushThread.interrupt();
+          flushThread.join();
+          writePending();
+
+          std::vector<char> block(RECORDING_BLOCK_HEADER_SIZE + 8 + index.size() * RECORDING_INDEX_ENTRY_SIZE, 0);
+          put<uint32_t>(block, RECORDING_BLOCK_HEADER_SIZE, index.size());
+          for (unsigned int i = 0; i < index.size(); ++i) {
+              const size_t entry = RECORDING_BLOCK_HEADER_SIZE + 8 + i * RECORDING_INDEX_ENTRY_SIZE;
+              put<uint64_t>(block, entry, index[i].offset);
+              put<uint32_t>(block, entry + 8, index[i].type);
+              put<uint32_t>(block, entry + 12, index[i].stream);
+              put<uint32_t>(block, entry + 16, index[i].count);
+              put<double>(block, entry + 24, index[i].firstTime);
+              put<double>(block, entry + 32, index[i].lastTime);
+          }
+          finishBlock(block, RECORDING_INDEX_BLOCK);
+          const uint64_t indexOffset = position;
+          write(block);
+
+          std::vector<char> trailer(RECORDING_TRAILER_SIZE);
+          put<uint64_t>(trailer, 0, indexOffset);
+          memcpy(&trailer[8], RECORDING_INDEX_MAGIC, 8);
+          write(trailer);
+
+          if (fclose(file) != 0) {
+              failed = true;
+          }
+          file = NULL;
+      }
+
+      //! Whether any write failed.
+      bool hasFailed() const {
+          return failed;
+      }
+
+      unsigned long getDroppedChunks() const {
+          return droppedChunks;
+      }
+
+      unsigned long getRecordCount() const {
+          return recordCount;
+      }
+
+      //! Bytes written. Only up to date once closed.
+      uint64_t getSize() const {
+          return position;
+      }
+
+    private:
+      struct StreamBuffer {
+        explicit StreamBuffer(const unsigned int columnCount) : columns(columnCount) {
+        }
+
+        std::vector<double> time;
+        std::vector<std::vector<float> > columns;
+      };
+
+      /**
+       * Block handed to the flusher, which owns and deletes the data once written.
+       */
+      struct PendingBlock {
+        PendingBlock() : data(NULL), type(0), stream(0), count(0), firstTime(0), lastTime(0) {
+        }
+
+        PendingBlock(std::vector<char>& _data, const uint32_t _type, const uint32_t _stream, const uint32_t _count,
+                const double _firstTime, const double _lastTime) :
+            data(new std::vector<char>()), type(_type), stream(_stream), count(_count), firstTime(_firstTime),
+            lastTime(_lastTime) {
+            data->swap(_data);
+        }
+
+        std::vector<char>* data;
+        uint32_t type;
+        uint32_t stream;
+        uint32_t count;
+        double firstTime;
+        double lastTime;
+      };
+
+      template<typename T>
+      static void put(std::vector<char>& data, const size_t offset, const T value) {
+          memcpy(&data[offset], &value, sizeof(T));
+      }
+
+      /**
+       * Pad the block to 8 bytes and fill in its header.
+       */
+      static void finishBlock(std::vector<char>& block, const uint32_t type) {
+          block.resize((block.size() + 7) / 8 * 8, 0);
+          put<uint32_t>(block, 0, type);
+          put<uint32_t>(block, 4, block.size() - RECORDING_BLOCK_HEADER_SIZE);
+      }
+
+      void queueChunk(const unsigned int stream) {
+          StreamBuffer& buffer = streams[stream];
+          const uint32_t count = buffer.time.size();
+          if (count == 0) {
+              return;
+          }
+
+          const size_t columnsStart = RECORDING_BLOCK_HEADER_SIZE + RECORDING_CHUNK_HEADER_SIZE + count * sizeof(double);
+          std::vector<char> block(columnsStart + buffer.columns.size() * count * sizeof(float));
+          put<uint32_t>(block, RECORDING_BLOCK_HEADER_SIZE, stream);
+          put<uint32_t>(block, RECORDING_BLOCK_HEADER_SIZE + 4, count);
+          put<double>(block, RECORDING_BLOCK_HEADER_SIZE + 8, buffer.time.front());
+          put<double>(block, RECORDING_BLOCK_HEADER_SIZE + 16, buffer.time.back());
+          memcpy(&block[RECORDING_BLOCK_HEADER_SIZE + RECORDING_CHUNK_HEADER_SIZE], &buffer.time[0],
+                  count * sizeof(double));
+          for (unsigned int i = 0; i < buffer.columns.size(); ++i) {
+              memcpy(&block[columnsStart + i * count * sizeof(float)], &buffer.columns[i][0], count * sizeof(float));
+          }
+          finishBlock(block, RECORDING_CHUNK_BLOCK);
+
+          const PendingBlock pending(block, RECORDING_CHUNK_BLOCK, stream, count, buffer.time.front(),
+                  buffer.time.back());
+          if (!ring.push(pending)) {
+              delete pending.data;
+              ++droppedChunks;
+          }
+
+          buffer.time.clear();
+          for (unsigned int i = 0; i < buffer.columns.size(); ++i) {
+              buffer.columns[i].clear();
+          }
+      }
+
+      /**
+       * Write the queued blocks until interrupted.
+       */
+      void flushLoop() {
+          try {
+              while (true) {
+                  boost::this_thread::sleep(boost::posix_time::milliseconds(RECORDING_FLUSH_MS));
+                  writePending();
+              }
+          }
+          catch (const boost::thread_interrupted&) {
+          }
+      }
+
+      /**
+       * Write the queued blocks. Flusher thread only, or after it stopped.
+       */
+      void writePending() {
+          pending.clear();
+          if (ring.drain(pending) == 0) {
+              return;
+          }
+          for (unsigned int i = 0; i < pending.size(); ++i) {
+              const PendingBlock& block = pending[i];
+              RecordingIndexEntry entry;
+              entry.offset = position;
+              entry.type = block.type;
+              entry.stream = block.stream;
+              entry.count = block.count;
+              entry.firstTime = block.firstTime;
+              entry.lastTime = block.lastTime;
+              index.push_back(entry);
+              write(*block.data);
+              delete block.data;
+          }
+          pending.clear();
+          if (fflush(file) != 0) {
+              failed = true;
+          }
+      }
+
+      void write(const std::vector<char>& data) {
+          if (fwrite(&data[0], 1, data.size(), file) != data.size()) {
+              failed = true;
+          }
+          position += data.size();
+      }
+
+      const unsigned int chunkSize;
+      FILE* file;
+      volatile bool failed;
+
+      //! Recording thread state.
+      std::vector<StreamBuffer> streams;
+
+      //! Flusher thread state.
+      uint64_t position;
+      std::vector<RecordingIndexEntry> index;
+      std::vector<PendingBlock> pending;
+
+      SingleProducerRing<PendingBlock> ring;
+      boost::thread flushThread;
+      unsigned long droppedChunks;
+      unsigned long recordCount;
+  };
+
+  /**
+   * Chunk of a recorded stream. The columns point into the memory map.
+   */
+  struct RecordedChunk {
+    uint32_t count;
+    double firstTime;
+    double lastTime;
+    const double* time;
+    std::vector<const float*> columns;
+  };
+
+  /**
+   * Stream of a recording with its chunks in time order.
+   */
+  struct RecordedStream {
+    std::string name;
+    std::vector<std::string> columnNames;
+    std::vector<RecordedChunk> chunks;
+
+    /**
+     * Index of a column, or -1 if the stream has no such column.
+     */
+    int findColumn(const std::string& columnName) const {
+        const std::vector<std::string>::const_iterator i = std::find(columnNames.begin(), columnNames.end(),
+                columnName);
+        return i == columnNames.end() ? -1 : i - columnNames.begin();
+    }
+
+    size_t getRecordCount() const {
+        size_t count = 0;
+        for (unsigned int i = 0; i < chunks.size(); ++i) {
+            count += chunks[i].count;
+        }
+        return count;
+    }
+
+    /**
+     * First chunk that ends at or after the time.
+     */
+    size_t findChunk(const double time) const {
+        size_t low = 0;
+        size_t high = chunks.size();
+        while (low < high) {
+            const size_t middle = (low + high) / 2;
+            if (chunks[middle].lastTime < time) {
+                low = middle + 1;
+            }
+            else {
+                high = middle;
+            }
+        }
+        return low;
+    }
+  };
+
+  /**
+   * Walks the records of a stream in time order. A missing stream has no records.
+   */
+  class RecordCursor {
+    public:
+      explicit RecordCursor(const RecordedStream* _stream) : stream(_stream), chunk(0), row(0) {
+          skipEmpty();
+      }
+
+      bool isValid() const {
+          return stream && chunk < stream->chunks.size();
+      }
+
+      double getTime() const {
+          return stream->chunks[chunk].time[row];
+      }
+
+      float getValue(const unsigned int column) const {
+          return stream->chunks[chunk].columns[column][row];
+      }
+
+      void next() {
+          if (++row >= stream->chunks[chunk].count) {
+              ++chunk;
+              row = 0;
+              skipEmpty();
+          }
+      }
+
+      /**
+       * Move to the first record at or after the time.
+       */
+      void seek(const double time) {
+          if (!stream) {
+              return;
+          }
+          chunk = stream->findChunk(time);
+          row = 0;
+          skipEmpty();
+          if (isValid()) {
+              const RecordedChunk& current = stream->chunks[chunk];
+              row = std::lower_bound(current.time, current.time + current.count, time) - current.time;
+          }
+      }
+
+    private:
+      void skipEmpty() {
+          while (isValid() && stream->chunks[chunk].count == 0) {
+              ++chunk;
+          }
+      }
+
+      const RecordedStream* stream;
+      size_t chunk;
+      uint32_t row;
+  };
+
+  /**
+   * Read only view of a recording through a memory map. Uses the index of a closed
+   * recording and walks the blocks of one that was not closed.
+   */
+  class Recording {
+    public:
+      Recording() : data(NULL), size(0), indexed(false) {
+      }
+
+      ~Recording() {
+          close();
+      }
+
+      /**
+       * Map and parse a recording.
+       * @return False if it could not be read. getError describes why.
+       */
+      bool open(const std::string& fileName) {
+          close();
+          const int fd = ::open(fileName.c_str(), O_RDONLY);
+          if (fd < 0) {
+              error = "cannot open " + fileName;
+              return false;
+          }
+          struct stat status;
+          if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < RECORDING_HEADER_SIZE) {
+              ::close(fd);
+              error = fileName + " is not a recording";
+              return false;
+          }
+          size = status.st_size;
+          void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+          ::close(fd);
+          if (mapped == MAP_FAILED) {
+              size = 0;
+              error = "cannot map " + fileName;
+              return false;
+          }
+          data = static_cast<const char*>(mapped);
+
+          if (memcmp(data, RECORDING_MAGIC, 8) != 0 || get<uint32_t>(8) != RECORDING_VERSION) {
+              error = fileName + " is not a version 1 recording";
+              close();
+              return false;
+          }
+          if (!parseIndex() && !parseBlocks()) {
+              error = fileName + " is corrupt: " + error;
+              close();
+              return false;
+          }
+          return true;
+      }
+
+      void close() {
+          if (data) {
+              munmap(const_cast<char*>(data), size);
+          }
+          data = NULL;
+          size = 0;
+          indexed = false;
+          streams.clear();
+          streamIndexes.clear();
+      }
+
+      const std::vector<RecordedStream>& getStreams() const {
+          return streams;
+      }
+
+      /**
+       * The stream with the name, or NULL if it was not recorded.
+       */
+      const RecordedStream* getStream(const std::string& name) const {
+          for (unsigned int i = 0; i < streams.size(); ++i) {
+              if (streams[i].name == name) {
+                  return &streams[i];
+              }
+          }
+          return NULL;
+      }
+
+      //! Whether the recording was closed and read through its index.
+      bool isIndexed() const {
+          return indexed;
+      }
+
+      const std::string& getError() const {
+          return error;
+      }
+
+    private:
+      template<typename T>
+      T get(const size_t offset) const {
+          T value;
+          memcpy(&value, data + offset, sizeof(T));
+          return value;
+      }
+
+      /**
+       * Read the blocks listed in the index.
+       */
+      bool parseIndex() {
+          if (size < RECORDING_HEADER_SIZE + RECORDING_TRAILER_SIZE
+                  || memcmp(data + size - 8, RECORDING_INDEX_MAGIC, 8) != 0) {
+              return false;
+          }
+          const uint64_t indexOffset = get<uint64_t>(size - RECORDING_TRAILER_SIZE);
+          size_t payload;
+          if (!checkBlock(indexOffset, RECORDING_INDEX_BLOCK, payload) || payload < 8) {
+              return false;
+          }
+          const uint32_t entries = get<uint32_t>(indexOffset + RECORDING_BLOCK_HEADER_SIZE);
+          if (8 + static_cast<uint64_t>(entries) * RECORDING_INDEX_ENTRY_SIZE > payload) {
+              return false;
+          }
+
+          for (uint32_t i = 0; i < entries; ++i) {
+              const size_t entry = indexOffset + RECORDING_BLOCK_HEADER_SIZE + 8 + i * RECORDING_INDEX_ENTRY_SIZE;
+              if (!parseBlock(get<uint64_t>(entry))) {
+                  streams.clear();
+                  streamIndexes.clear();
+                  return false;
+              }
+          }
+          indexed = true;
+          return true;
+      }
+
+      /**
+       * Walk the blocks from the start. A truncated last block is ignored.
+       */
+      bool parseBlocks() {
+          size_t offset = RECORDING_HEADER_SIZE;
+          while (offset + RECORDING_BLOCK_HEADER_SIZE <= size) {
+              const size_t end = offset + RECORDING_BLOCK_HEADER_SIZE + get<uint32_t>(offset + 4);
+              if (end > size) {
+                  break;
+              }
+              if (get<uint32_t>(offset) != RECORDING_INDEX_BLOCK && !parseBlock(offset)) {
+                  return false;
+              }
+              offset = end;
+          }
+          return true;
+      }
+
+      bool checkBlock(const uint64_t offset, const uint32_t type, size_t& payload) const {
+          if (offset % 8 != 0 || offset + RECORDING_BLOCK_HEADER_SIZE > size || get<uint32_t>(offset) != type) {
+              return false;
+          }
+          payload = get<uint32_t>(offset + 4);
+          return offset + RECORDING_BLOCK_HEADER_SIZE + payload <= size;
+      }
+
+      bool parseBlock(const uint64_t offset) {
+          if (offset + RECORDING_BLOCK_HEADER_SIZE > size) {
+              error = "block past the end of the file";
+              return false;
+          }
+          size_t payload;
+          const uint32_t type = get<uint32_t>(offset);
+          if (!checkBlock(offset, type, payload)) {
+              error = "block past the end of the file";
+              return false;
+          }
+          const size_t start = offset + RECORDING_BLOCK_HEADER_SIZE;
+          if (type == RECORDING_STREAM_BLOCK) {
+              return parseStream(start, payload);
+          }
+          if (type == RECORDING_CHUNK_BLOCK) {
+              return parseChunk(start, payload);
+          }
+          // Skip blocks from later versions.
+          return true;
+      }
+
+      bool parseStream(const size_t start, const size_t payload) {
+          if (payload < 8) {
+              error = "short stream block";
+              return false;
+          }
+          const uint32_t id = get<uint32_t>(start);
+          const uint32_t columnCount = get<uint32_t>(start + 4);
+
+          RecordedStream stream;
+          size_t offset = start + 8;
+          const size_t end = start + payload;
+          for (uint32_t i = 0; i <= columnCount; ++i) {
+              const char* name = data + offset;
+              const size_t length = strnlen(name, end - offset);
+              if (offset + length >= end) {
+                  error = "unterminated stream name";
+                  return false;
+              }
+              if (i == 0) {
+                  stream.name = std::string(name, length);
+              }
+              else {
+                  stream.columnNames.push_back(std::string(name, length));
+              }
+              offset += length + 1;
+          }
+
+          if (streamIndexes.count(id)) {
+              error = "stream " + stream.name + " defined twice";
+              return false;
+          }
+          streamIndexes[id] = streams.size();
+          streams.push_back(stream);
+          return true;
+      }
+
+      bool parseChunk(const size_t start, const size_t payload) {
+          if (payload < RECORDING_CHUNK_HEADER_SIZE) {
+              error = "short chunk block";
+              return false;
+          }
+          const std::map<uint32_t, size_t>::const_iterator stream = streamIndexes.find(get<uint32_t>(start));
+          if (stream == streamIndexes.end()) {
+              error = "chunk of an undefined stream";
+              return false;
+          }
+          RecordedStream& recorded = streams[stream->second];
+
+          RecordedChunk chunk;
+          chunk.count = get<uint32_t>(start + 4);
+          chunk.firstTime = get<double>(start + 8);
+          chunk.lastTime = get<double>(start + 16);
+          const size_t columnsStart = RECORDING_CHUNK_HEADER_SIZE + chunk.count * sizeof(double);
+          if (columnsStart + static_cast<uint64_t>(recorded.columnNames.size()) * chunk.count * sizeof(float)
+                  > payload) {
+              error = "short chunk of " + recorded.name;
+              return false;
+          }
+          chunk.time = reinterpret_cast<const double*>(data + start + RECORDING_CHUNK_HEADER_SIZE);
+          for (unsigned int i = 0; i < recorded.columnNames.size(); ++i) {
+              chunk.columns.push_back(
+                      reinterpret_cast<const float*>(data + start + columnsStart + i * chunk.count * sizeof(float)));
+          }
+          recorded.chunks.push_back(chunk);
+          return true;
+      }
+
+      const char* data;
+      size_t size;
+      bool indexed;
+      std::string error;
+      std::vector<RecordedStream> streams;
+
+      //! Position in streams of each stream id.
+      std::map<uint32_t, size_t> streamIndexes;
+  };
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "path_provider.h"
+#include "piecewise_linear_path_provider.h"
+#include <string>
+#include <vector>
+#include <tf2/LinearMath/btVector3.h>
+
+namespace {
+
+  /**
+   * Piecewise linear path built from a segment list, such as one received in a
+   * PathDescription.
+   */
+  class SegmentListPathProvider : public PiecewiseLinearPathProvider {
+      public:
+        SegmentListPathProvider(const std::string& _pathType, const std::vector<btVector3>& _segments,
+                const double _roundingDistance, const double _velocity) :
+                    PiecewiseLinearPathProvider(_roundingDistance, _velocity),
+                    pathType(_pathType), segmentList(_segments) {}
+        virtual ~SegmentListPathProvider(){}
+        virtual void describe(dogsim::PathDescription& description) const {
+            PiecewiseLinearPathProvider::describe(description);
+            description.pathType = pathType;
+        }
+      protected:
+        virtual std::vector<btVector3> getSegments() const {
+            return segmentList;
+        }
+      private:
+        const std::string pathType;
+        const std::vector<btVector3> segmentList;
+  };
+}
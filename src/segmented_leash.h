@@ -0,0 +1,324 @@
+#pragma once
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+  //! Upper bound on the number of segments so the cost per update stays bounded.
+  const unsigned int MAX_LEASH_SEGMENTS = 64;
+
+  const double LEASH_GRAVITY = -9.81;
+
+  //! Upper bound on the number of bodies the leash wraps around.
+  const unsigned int MAX_LEASH_OBSTACLES = 4;
+
+  /**
+   * Body the leash wraps around, as a vertical cylinder from bottom to top.
+   */
+  struct LeashObstacle {
+      LeashObstacle() : x(0), y(0), bottom(0), top(0), radius(0) {
+      }
+
+      LeashObstacle(const double _x, const double _y, const double _bottom, const double _top,
+              const double _radius) :
+          x(_x), y(_y), bottom(_bottom), top(std::max(_bottom, _top)), radius(_radius) {
+      }
+
+      double x;
+      double y;
+      double bottom;
+      double top;
+      double radius;
+  };
+
+  /**
+   * Leash made of point masses joined by distance constraints and solved with
+   * extended position based dynamics (XPBD). The first point is pinned to the
+   * hand and the last to the dog. The free points are kept above the ground and
+   * out of up to MAX_LEASH_OBSTACLES bodies, so the leash wraps around them. Each
+   * step runs a fixed number of constraint iterations, so its cost is
+   * O(iterations * segments * obstacles) regardless of the state.
+   */
+  class SegmentedLeash {
+    public:
+      /**
+       * @param segments Number of segments. Clamped to [1, MAX_LEASH_SEGMENTS].
+       * @param length Rest length of the whole leash.
+       * @param iterations Constraint iterations per step.
+       * @param _compliance Inverse stiffness of the whole leash in m/N. Split evenly over the segments.
+       * @param _damping Fraction of velocity lost per second to drag.
+       * @param mass Mass of the whole leash.
+       */
+      SegmentedLeash(const unsigned int segments, const double length, const unsigned int iterations,
+              const double _compliance, const double _damping, const double mass) :
+          segmentCount(std::max(1u, std::min(segments, MAX_LEASH_SEGMENTS))),
+          segmentLength(length / segmentCount), iterationCount(std::max(1u, iterations)),
+          compliance(_compliance / segmentCount), damping(_damping), initialized(false), lastDt(0),
+          obstacleCount(0) {
+
+          const unsigned int pointCount = segmentCount + 1;
+          x.resize(pointCount, 0.0);
+          y.resize(pointCount, 0.0);
+          z.resize(pointCount, 0.0);
+          previousX.resize(pointCount, 0.0);
+          previousY.resize(pointCount, 0.0);
+          previousZ.resize(pointCount, 0.0);
+          velocityX.resize(pointCount, 0.0);
+          velocityY.resize(pointCount, 0.0);
+          velocityZ.resize(pointCount, 0.0);
+          lambda.resize(segmentCount, 0.0);
+
+          // The ends are pinned and never moved by the solver.
+          inverseMass.resize(pointCount, segmentCount / mass);
+          inverseMass.front() = inverseMass.back() = 0.0;
+      }
+
+      void clearObstacles() {
+          obstacleCount = 0;
+      }
+
+      /**
+       * Wrap the leash around a body from the next step on.
+       * @return False if there are already MAX_LEASH_OBSTACLES bodies.
+       */
+      bool addObstacle(const LeashObstacle& obstacle) {
+          if (obstacleCount >= MAX_LEASH_OBSTACLES) {
+              return false;
+          }
+          obstacles[obstacleCount++] = obstacle;
+          return true;
+      }
+
+      /**
+       * Advance the leash by dt with its ends at the hand and dog positions.
+       */
+      void step(const double dt, const double handX, const double handY, const double handZ,
+              const double dogX, const double dogY, const double dogZ) {
+          if (!initialized) {
+              layOut(handX, handY, handZ, dogX, dogY, dogZ);
+          }
+          if (dt <= 0) {
+              return;
+          }
+          lastDt = dt;
+
+          // Predict the free points under gravity and drag.
+          const unsigned int last = segmentCount;
+          const double drag = std::max(0.0, 1.0 - damping * dt);
+          for (unsigned int i = 0; i <= last; ++i) {
+              previousX[i] = x[i];
+              previousY[i] = y[i];
+              previousZ[i] = z[i];
+              velocityZ[i] += inverseMass[i] > 0 ? LEASH_GRAVITY * dt : 0.0;
+              x[i] += velocityX[i] * drag * dt;
+              y[i] += velocityY[i] * drag * dt;
+              z[i] += velocityZ[i] * drag * dt;
+          }
+          x[0] = handX;
+          y[0] = handY;
+          z[0] = handZ;
+          x[last] = dogX;
+          y[last] = dogY;
+          z[last] = dogZ;
+
+          std::fill(lambda.begin(), lambda.end(), 0.0);
+          findWrappedPoints();
+          const double alphaTilde = compliance / (dt * dt);
+          for (unsigned int iteration = 0; iteration < iterationCount; ++iteration) {
+              for (unsigned int j = 0; j < segmentCount; ++j) {
+                  solveDistance(j, alphaTilde);
+              }
+
+              // Keep the free points above the ground and outside the bodies.
+              for (unsigned int i = 1; i < last; ++i) {
+                  z[i] = std::max(z[i], 0.0);
+                  projectOutOfObstacles(i);
+              }
+          }
+
+          for (unsigned int i = 0; i <= last; ++i) {
+              velocityX[i] = (x[i] - previousX[i]) / dt;
+              velocityY[i] = (y[i] - previousY[i]) / dt;
+              velocityZ[i] = (z[i] - previousZ[i]) / dt;
+          }
+      }
+
+      /**
+       * Tension in a segment from the last step. The leash can pull but not push.
+       */
+      double getTension(const unsigned int segment) const {
+          return lastDt > 0 ? std::max(-lambda[segment] / (lastDt * lastDt), 0.0) : 0.0;
+      }
+
+      /**
+       * Unit direction from point i towards point j.
+       */
+      void getDirection(const unsigned int i, const unsigned int j, double& dx, double& dy, double& dz) const {
+          dx = x[j] - x[i];
+          dy = y[j] - y[i];
+          dz = z[j] - z[i];
+          const double length = sqrt(dx * dx + dy * dy + dz * dz);
+          if (length > 0) {
+              dx /= length;
+              dy /= length;
+              dz /= length;
+          }
+      }
+
+      unsigned int getSegmentCount() const {
+          return segmentCount;
+      }
+
+      double getX(const unsigned int i) const {
+          return x[i];
+      }
+
+      double getY(const unsigned int i) const {
+          return y[i];
+      }
+
+      double getZ(const unsigned int i) const {
+          return z[i];
+      }
+
+    private:
+      /**
+       * Place the points on the straight line between the ends, at rest.
+       */
+      void layOut(const double handX, const double handY, const double handZ,
+              const double dogX, const double dogY, const double dogZ) {
+          for (unsigned int i = 0; i <= segmentCount; ++i) {
+              const double fraction = static_cast<double>(i) / segmentCount;
+              x[i] = handX + fraction * (dogX - handX);
+              y[i] = handY + fraction * (dogY - handY);
+              z[i] = handZ + fraction * (dogZ - handZ);
+          }
+          lastDt = 0;
+          initialized = true;
+      }
+
+      /**
+       * How far a point is inside a body through whichever of the side and the top is
+       * nearer, or 0 if it is outside. The bodies stand on the ground, so nothing
+       * leaves through the bottom.
+       */
+      static double exitDepth(const LeashObstacle& obstacle, const double px, const double py, const double pz) {
+          if (pz <= obstacle.bottom || pz >= obstacle.top) {
+              return 0.0;
+          }
+          const double radial = sqrt((px - obstacle.x) * (px - obstacle.x) + (py - obstacle.y) * (py - obstacle.y));
+          return std::max(std::min(obstacle.radius - radial, obstacle.top - pz), 0.0);
+      }
+
+      /**
+       * Find the free points each body acts on. An end pinned inside a body, like the
+       * dog's end inside the dog, has to leave it along the leash, so the points
+       * closer to that end than its depth are left alone.
+       */
+      void findWrappedPoints() {
+          const unsigned int last = segmentCount;
+          for (unsigned int k = 0; k < obstacleCount; ++k) {
+              const double handDepth = exitDepth(obstacles[k], x[0], y[0], z[0]);
+              const double dogDepth = exitDepth(obstacles[k], x[last], y[last], z[last]);
+              firstWrapped[k] = std::max(1u, static_cast<unsigned int>(ceil(handDepth / segmentLength)));
+              const unsigned int dogPoints = std::max(1u, static_cast<unsigned int>(ceil(dogDepth / segmentLength)));
+              lastWrapped[k] = dogPoints < last ? last - dogPoints : 0;
+          }
+      }
+
+      /**
+       * Move point i out of any body it is inside, through the nearer of the side and the top.
+       */
+      void projectOutOfObstacles(const unsigned int i) {
+          for (unsigned int k = 0; k < obstacleCount; ++k) {
+              const LeashObstacle& obstacle = obstacles[k];
+              if (i < firstWrapped[k] || i > lastWrapped[k] || exitDepth(obstacle, x[i], y[i], z[i]) <= 0) {
+                  continue;
+              }
+
+              const double dx = x[i] - obstacle.x;
+              const double dy = y[i] - obstacle.y;
+              const double radial = sqrt(dx * dx + dy * dy);
+              if (obstacle.top - z[i] < obstacle.radius - radial) {
+                  z[i] = obstacle.top;
+              }
+              else if (radial > 0) {
+                  x[i] = obstacle.x + dx * obstacle.radius / radial;
+                  y[i] = obstacle.y + dy * obstacle.radius / radial;
+              }
+              else {
+                  // On the axis there is no nearest side, so pick one.
+                  x[i] = obstacle.x + obstacle.radius;
+              }
+          }
+      }
+
+      /**
+       * One XPBD update of the distance constraint between points j and j + 1.
+       */
+      void solveDistance(const unsigned int j, const double alphaTilde) {
+          const unsigned int a = j;
+          const unsigned int b = j + 1;
+          const double weight = inverseMass[a] + inverseMass[b];
+          if (weight + alphaTilde <= 0) {
+              return;
+          }
+
+          const double dx = x[b] - x[a];
+          const double dy = y[b] - y[a];
+          const double dz = z[b] - z[a];
+          const double length = sqrt(dx * dx + dy * dy + dz * dz);
+          if (length <= 0) {
+              return;
+          }
+
+          // The leash only pulls, so the multiplier is kept non positive and a short segment goes slack.
+          const double constraint = length - segmentLength;
+          const double newLambda = std::min(lambda[j] + (-constraint - alphaTilde * lambda[j]) / (weight + alphaTilde), 0.0);
+          const double deltaLambda = newLambda - lambda[j];
+          lambda[j] = newLambda;
+
+          const double scale = deltaLambda / length;
+          x[a] -= inverseMass[a] * scale * dx;
+          y[a] -= inverseMass[a] * scale * dy;
+          z[a] -= inverseMass[a] * scale * dz;
+          x[b] += inverseMass[b] * scale * dx;
+          y[b] += inverseMass[b] * scale * dy;
+          z[b] += inverseMass[b] * scale * dz;
+      }
+
+      const unsigned int segmentCount;
+      const double segmentLength;
+      const unsigned int iterationCount;
+      //! Compliance of each segment.
+      const double compliance;
+      const double damping;
+
+      bool initialized;
+      double lastDt;
+
+      //! Point state in contiguous arrays.
+      std::vector<double> x;
+      std::vector<double> y;
+      std::vector<double> z;
+      std::vector<double> previousX;
+      std::vector<double> previousY;
+      std::vector<double> previousZ;
+      std::vector<double> velocityX;
+      std::vector<double> velocityY;
+      std::vector<double> velocityZ;
+      std::vector<double> inverseMass;
+
+      //! Accumulated constraint multipliers of the current step.
+      std::vector<double> lambda;
+
+      //! Bodies the leash wraps around. Fixed size so the physics thread does not allocate.
+      LeashObstacle obstacles[MAX_LEASH_OBSTACLES];
+      unsigned int obstacleCount;
+
+      //! Range of free points each body acts on in the current step.
+      unsigned int firstWrapped[MAX_LEASH_OBSTACLES];
+      unsigned int lastWrapped[MAX_LEASH_OBSTACLES];
+  };
+}
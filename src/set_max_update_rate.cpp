@@ -11,6 +11,9 @@ public:
   SetMaxUpdateRate(): _pnh("~"){
     ROS_INFO("Setting the max update rate");
     _pnh.param<double>("max_update_rate", _maxUpdateRate, 1000);
+
+    // A global rate overrides the launch files, e.g. 0 to run as fast as the CPU allows.
+    _nh.getParam("/max_update_rate", _maxUpdateRate);
   }
 
   void setMaxUpdateRate(){
@@ -0,0 +1,64 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+namespace {
+
+  /**
+   * Fixed capacity ring buffer for exactly one producer thread and one consumer
+   * thread. Neither side locks. Each index is only written by its own side, and
+   * memory barriers order the element writes against the index updates.
+   */
+  template<typename T>
+  class SingleProducerRing {
+    public:
+      explicit SingleProducerRing(const size_t capacity) :
+          elements(capacity + 1), head(0), tail(0) {
+      }
+
+      /**
+       * Add an element. Producer thread only.
+       * @return False if the ring is full and the element was dropped.
+       */
+      bool push(const T& element) {
+          const size_t next = advance(tail);
+          if (next == head) {
+              return false;
+          }
+          elements[tail] = element;
+          __sync_synchronize();
+          tail = next;
+          return true;
+      }
+
+      /**
+       * Move every available element to the end of out. Consumer thread only.
+       * @return The number of elements moved.
+       */
+      size_t drain(std::vector<T>& out) {
+          const size_t end = tail;
+          __sync_synchronize();
+          size_t count = 0;
+          size_t current = head;
+          for (; current != end; current = advance(current), ++count) {
+              out.push_back(elements[current]);
+          }
+          __sync_synchronize();
+          head = current;
+          return count;
+      }
+
+    private:
+      size_t advance(const size_t index) const {
+          return index + 1 == elements.size() ? 0 : index + 1;
+      }
+
+      std::vector<T> elements;
+
+      //! Next element to read. Only written by the consumer.
+      volatile size_t head;
+
+      //! Next slot to write. Only written by the producer.
+      volatile size_t tail;
+  };
+}
@@ -0,0 +1,268 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <boost/thread/thread.hpp>
+#include <boost/shared_ptr.hpp>
+#include <stdint.h>
+
+namespace {
+
+  //! Number of power of two buckets. The last bucket holds everything from 2^31 ns (about 2 s) up.
+  const unsigned int TICK_HISTOGRAM_BUCKETS = 32;
+
+  //! Stage that covers the whole tick.
+  const unsigned int TICK_STAGE = 0;
+
+  //! Default time between diagnostics messages in seconds.
+  const double PROFILE_PERIOD_DEFAULT = 5.0;
+
+  /**
+   * Histogram of durations in nanoseconds with power of two buckets. Recording uses
+   * atomic adds, so a reader thread can summarize it while its writer records. Each
+   * histogram must only be recorded from one thread.
+   */
+  class TickHistogram {
+    public:
+      TickHistogram() : count(0), total(0), maximum(0) {
+          for (unsigned int i = 0; i < TICK_HISTOGRAM_BUCKETS; ++i) {
+              buckets[i] = 0;
+          }
+      }
+
+      void record(const uint64_t nanoseconds) {
+          unsigned int bucket = 0;
+          for (uint64_t remaining = nanoseconds >> 1; remaining && bucket + 1 < TICK_HISTOGRAM_BUCKETS;
+                  remaining >>= 1) {
+              ++bucket;
+          }
+          __sync_fetch_and_add(&buckets[bucket], 1);
+          __sync_fetch_and_add(&count, 1);
+          __sync_fetch_and_add(&total, nanoseconds);
+
+          // Each histogram has a single writer thread, so a plain compare is enough for the maximum.
+          if (nanoseconds > maximum) {
+              maximum = nanoseconds;
+          }
+      }
+
+      uint64_t getCount() const {
+          return count;
+      }
+
+      double getMeanMicroseconds() const {
+          return count > 0 ? total / 1000.0 / count : 0.0;
+      }
+
+      double getMaximumMicroseconds() const {
+          return maximum / 1000.0;
+      }
+
+      /**
+       * Upper bound of the bucket that contains the quantile, in microseconds.
+       */
+      double getQuantileMicroseconds(const double quantile) const {
+          const uint64_t samples = count;
+          uint64_t seen = 0;
+          for (unsigned int i = 0; i < TICK_HISTOGRAM_BUCKETS; ++i) {
+              seen += buckets[i];
+              if (samples > 0 && seen >= quantile * samples) {
+                  return (uint64_t(2) << i) / 1000.0;
+              }
+          }
+          return getMaximumMicroseconds();
+      }
+
+      uint64_t getBucket(const unsigned int i) const {
+          return buckets[i];
+      }
+
+    private:
+      volatile uint64_t buckets[TICK_HISTOGRAM_BUCKETS];
+      volatile uint64_t count;
+      volatile uint64_t total;
+      volatile uint64_t maximum;
+  };
+
+  /**
+   * Per tick wall time profiler for the Gazebo plugins. Stage 0 is the whole tick and
+   * further stages break it down. When disabled, timing a stage costs one branch.
+   *
+   * Enabled by the profile_plugins parameter. Summaries are published on
+   * /diagnostics every profile_period seconds, and written to
+   * <profile_directory>/<name>.profile at shutdown if profile_directory is set.
+   */
+  class TickProfiler {
+    public:
+      explicit TickProfiler(const std::string& _name) : name(_name), enabled(false) {
+          stageNames.push_back("tick");
+          histograms.push_back(boost::shared_ptr<TickHistogram>(new TickHistogram()));
+      }
+
+      ~TickProfiler() {
+          publishThread.interrupt();
+          publishThread.join();
+          dump();
+      }
+
+      /**
+       * Add a sub stage. Must be called before start.
+       * @return The stage index to time.
+       */
+      unsigned int addStage(const std::string& stageName) {
+          stageNames.push_back(stageName);
+          histograms.push_back(boost::shared_ptr<TickHistogram>(new TickHistogram()));
+          return stageNames.size() - 1;
+      }
+
+      /**
+       * Read the parameters and begin publishing if profiling is enabled.
+       * @param enabledByDefault Whether to profile when profile_plugins is not set.
+       */
+      void start(ros::NodeHandle& nh, const bool enabledByDefault = false) {
+          nh.param<bool>("profile_plugins", enabled, enabledByDefault);
+          if (!enabled) {
+              return;
+          }
+          nh.param<std::string>("profile_directory", directory, "");
+          double period;
+          nh.param<double>("profile_period", period, PROFILE_PERIOD_DEFAULT);
+
+          diagnosticsPub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+          publishThread = boost::thread(&TickProfiler::publishLoop, this, period);
+          ROS_INFO("Profiling %s ticks", name.c_str());
+      }
+
+      bool isEnabled() const {
+          return enabled;
+      }
+
+      void record(const unsigned int stage, const ros::WallDuration& duration) {
+          histograms[stage]->record(duration.toNSec());
+      }
+
+      /**
+       * Log the summary of every stage.
+       */
+      void logSummary() const {
+          if (!enabled) {
+              return;
+          }
+          for (unsigned int i = 0; i < histograms.size(); ++i) {
+              const TickHistogram& histogram = *histograms[i];
+              ROS_INFO("%s %s count: %lu mean: %f us p50: %f us p99: %f us max: %f us", name.c_str(),
+                      stageNames[i].c_str(), static_cast<unsigned long>(histogram.getCount()),
+                      histogram.getMeanMicroseconds(), histogram.getQuantileMicroseconds(0.5),
+                      histogram.getQuantileMicroseconds(0.99), histogram.getMaximumMicroseconds());
+          }
+      }
+
+    private:
+      void publishLoop(const double period) {
+          const boost::posix_time::milliseconds sleepTime(static_cast<long>(period * 1000));
+          while (ros::ok()) {
+              boost::this_thread::sleep(sleepTime);
+              publish();
+          }
+      }
+
+      void publish() {
+          diagnostic_msgs::DiagnosticArray diagnostics;
+          diagnostics.header.stamp = ros::Time::now();
+          diagnostics.status.resize(1);
+
+          diagnostic_msgs::DiagnosticStatus& status = diagnostics.status[0];
+          status.level = diagnostic_msgs::DiagnosticStatus::OK;
+          status.name = "dogsim/" + name;
+          status.hardware_id = name;
+          status.message = "Update tick wall time in microseconds";
+          for (unsigned int i = 0; i < histograms.size(); ++i) {
+              const TickHistogram& histogram = *histograms[i];
+              addValue(status, stageNames[i] + " count", histogram.getCount());
+              addValue(status, stageNames[i] + " mean", histogram.getMeanMicroseconds());
+              addValue(status, stageNames[i] + " p50", histogram.getQuantileMicroseconds(0.5));
+              addValue(status, stageNames[i] + " p99", histogram.getQuantileMicroseconds(0.99));
+              addValue(status, stageNames[i] + " max", histogram.getMaximumMicroseconds());
+          }
+          diagnosticsPub.publish(diagnostics);
+      }
+
+      template<typename T>
+      static void addValue(diagnostic_msgs::DiagnosticStatus& status, const std::string& key, const T value) {
+          std::ostringstream stream;
+          stream << value;
+          diagnostic_msgs::KeyValue keyValue;
+          keyValue.key = key;
+          keyValue.value = stream.str();
+          status.values.push_back(keyValue);
+      }
+
+      /**
+       * Write the summary and buckets of every stage.
+       */
+      void dump() const {
+          if (!enabled || directory.empty()) {
+              return;
+          }
+          const std::string fileName = directory + "/" + name + ".profile";
+          std::ofstream out(fileName.c_str());
+          out << "# stage count mean_us p50_us p99_us max_us then counts of buckets [2^i, 2^(i+1)) ns" << std::endl;
+          for (unsigned int i = 0; i < histograms.size(); ++i) {
+              const TickHistogram& histogram = *histograms[i];
+              out << stageNames[i] << " " << histogram.getCount() << " " << histogram.getMeanMicroseconds()
+                      << " " << histogram.getQuantileMicroseconds(0.5) << " "
+                      << histogram.getQuantileMicroseconds(0.99) << " " << histogram.getMaximumMicroseconds();
+              for (unsigned int j = 0; j < TICK_HISTOGRAM_BUCKETS; ++j) {
+                  out << " " << histogram.getBucket(j);
+              }
+              out << std::endl;
+          }
+          if (!out) {
+              ROS_ERROR("Failed to write profile %s", fileName.c_str());
+          }
+      }
+
+      const std::string name;
+      bool enabled;
+      std::string directory;
+
+      std::vector<std::string> stageNames;
+      std::vector<boost::shared_ptr<TickHistogram> > histograms;
+
+      ros::Publisher diagnosticsPub;
+      boost::thread publishThread;
+  };
+
+  /**
+   * Times a stage from construction until stop or destruction.
+   */
+  class StageTimer {
+    public:
+      StageTimer(TickProfiler& _profiler, const unsigned int _stage) :
+          profiler(_profiler), stage(_stage), running(_profiler.isEnabled()) {
+          if (running) {
+              startTime = ros::WallTime::now();
+          }
+      }
+
+      ~StageTimer() {
+          stop();
+      }
+
+      void stop() {
+          if (running) {
+              profiler.record(stage, ros::WallTime::now() - startTime);
+              running = false;
+          }
+      }
+
+    private:
+      TickProfiler& profiler;
+      const unsigned int stage;
+      bool running;
+      ros::WallTime startTime;
+  };
+}
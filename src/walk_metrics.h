@@ -0,0 +1,409 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+  //! Standing height of the dog, which the height deviation is measured from.
+  const double DOG_HEIGHT_DEFAULT = 0.1;
+
+  //! Length of the leash, which the stretch is measured past.
+  const double LEASH_LENGTH_DEFAULT = 1.5;
+
+  //! Named results of a metric, in the order they are reported.
+  typedef std::vector<std::pair<std::string, double> > MetricValues;
+
+  /**
+   * Value of a named result. Zero if the metric did not report it.
+   */
+  static double getValue(const MetricValues& values, const std::string& name) {
+      for (MetricValues::const_iterator i = values.begin(); i != values.end(); ++i) {
+          if (i->first == name) {
+              return i->second;
+          }
+      }
+      return 0.0;
+  }
+
+  /**
+   * Sum with Kahan compensation. A long walk sums many small terms into a large
+   * total, which would otherwise lose the low order bits.
+   */
+  class CompensatedSum {
+    public:
+      CompensatedSum() : sum(0), compensation(0) {
+      }
+
+      void add(const double value) {
+          const double y = value - compensation;
+          const double t = sum + y;
+          compensation = (t - sum) - y;
+          sum = t;
+      }
+
+      double get() const {
+          return sum;
+      }
+
+    private:
+      double sum;
+      double compensation;
+  };
+
+  /**
+   * Mean, sample variance and maximum in a single pass with Welford's method.
+   */
+  class RunningStatistics {
+    public:
+      RunningStatistics() : n(0), mean(0), m2(0), maximum(0) {
+      }
+
+      void add(const double x) {
+          ++n;
+          const double delta = x - mean;
+          mean += delta / n;
+          m2 += delta * (x - mean);
+          maximum = n == 1 ? x : std::max(maximum, x);
+      }
+
+      unsigned int getCount() const {
+          return n;
+      }
+
+      double getMean() const {
+          return mean;
+      }
+
+      double getVariance() const {
+          return n > 1 ? m2 / (n - 1) : 0.0;
+      }
+
+      double getMaximum() const {
+          return maximum;
+      }
+
+    private:
+      unsigned int n;
+      double mean;
+      double m2;
+      double maximum;
+  };
+
+  /**
+   * Integral over time of a sampled value with the trapezoidal rule. The first
+   * sample starts the integral. Samples that do not advance time add nothing.
+   */
+  class TrapezoidIntegral {
+    public:
+      TrapezoidIntegral() : started(false), lastTime(0), lastValue(0) {
+      }
+
+      void add(const double time, const double value) {
+          if (started && time > lastTime) {
+              total.add((time - lastTime) * (value + lastValue) / 2.0);
+          }
+          if (!started || time > lastTime) {
+              lastTime = time;
+              lastValue = value;
+          }
+          started = true;
+      }
+
+      double get() const {
+          return total.get();
+      }
+
+    private:
+      bool started;
+      double lastTime;
+      double lastValue;
+      CompensatedSum total;
+  };
+
+  /**
+   * Path sampled at a uniform time increment. A time is looked up by index
+   * arithmetic and interpolated between the neighbouring samples. Times outside
+   * the path clamp to its ends.
+   */
+  class UniformPath {
+    public:
+      UniformPath() : startTime(0), increment(0) {
+      }
+
+      void reset(const double _startTime, const double _increment) {
+          startTime = _startTime;
+          increment = _increment;
+          x.clear();
+          y.clear();
+          z.clear();
+      }
+
+      void add(const double px, const double py, const double pz) {
+          x.push_back(px);
+          y.push_back(py);
+          z.push_back(pz);
+      }
+
+      bool empty() const {
+          return x.empty();
+      }
+
+      /**
+       * Position at a time. The path must not be empty.
+       */
+      void positionAt(const double time, double& px, double& py, double& pz) const {
+          const size_t last = x.size() - 1;
+          const double u = increment > 0 ? (time - startTime) / increment : 0.0;
+          if (u <= 0 || last == 0) {
+              px = x.front();
+              py = y.front();
+              pz = z.front();
+              return;
+          }
+          if (u >= last) {
+              px = x.back();
+              py = y.back();
+              pz = z.back();
+              return;
+          }
+
+          const size_t i = static_cast<size_t>(u);
+          const double fraction = u - i;
+          px = x[i] + fraction * (x[i + 1] - x[i]);
+          py = y[i] + fraction * (y[i + 1] - y[i]);
+          pz = z[i] + fraction * (z[i + 1] - z[i]);
+      }
+
+    private:
+      double startTime;
+      double increment;
+      std::vector<double> x;
+      std::vector<double> y;
+      std::vector<double> z;
+  };
+
+  /**
+   * Squared distance of the dog from its goal integrated over the walk, and the
+   * mean height of the dog above its standing height.
+   */
+  class PathDeviationMetric {
+    public:
+      explicit PathDeviationMetric(const double _dogHeight) : dogHeight(_dogHeight) {
+      }
+
+      void add(const double time, const double deviation, const double height) {
+          deviationSquared.add(time, deviation * deviation);
+          heightDeviation.add(height - dogHeight);
+      }
+
+      unsigned int getCount() const {
+          return heightDeviation.getCount();
+      }
+
+      void getValues(MetricValues& values) const {
+          values.push_back(std::make_pair("path_deviation", deviationSquared.get()));
+          values.push_back(std::make_pair("height_deviation", heightDeviation.getMean()));
+      }
+
+    private:
+      const double dogHeight;
+      TrapezoidIntegral deviationSquared;
+      RunningStatistics heightDeviation;
+  };
+
+  /**
+   * Squared distance of the robot base from its planned pose integrated over the walk.
+   */
+  class RobotPathDeviationMetric {
+    public:
+      RobotPathDeviationMetric() : count(0) {
+      }
+
+      void add(const double time, const double deviation) {
+          deviationSquared.add(time, deviation * deviation);
+          ++count;
+      }
+
+      unsigned int getCount() const {
+          return count;
+      }
+
+      void getValues(MetricValues& values) const {
+          values.push_back(std::make_pair("robot_deviation", deviationSquared.get()));
+      }
+
+    private:
+      TrapezoidIntegral deviationSquared;
+      unsigned int count;
+  };
+
+  /**
+   * Leash force integrated over the walk, and how far the leash stretched past its length.
+   */
+  class LeashForceMetric {
+    public:
+      explicit LeashForceMetric(const double _leashLength) : leashLength(_leashLength) {
+      }
+
+      void add(const double time, const double force, const double distance) {
+          totalForce.add(time, force);
+          stretch.add(std::max(distance - leashLength, 0.0));
+      }
+
+      void getValues(MetricValues& values) const {
+          values.push_back(std::make_pair("leash_force", totalForce.get()));
+          values.push_back(std::make_pair("stretch_mean", stretch.getMean()));
+          values.push_back(std::make_pair("stretch_variance", stretch.getVariance()));
+          values.push_back(std::make_pair("stretch_max", stretch.getMaximum()));
+      }
+
+    private:
+      const double leashLength;
+      TrapezoidIntegral totalForce;
+      RunningStatistics stretch;
+  };
+
+  /**
+   * Squared joint effort impulse summed over the joints and the walk.
+   */
+  class JointEffortMetric {
+    public:
+      JointEffortMetric() : started(false), lastTime(0) {
+      }
+
+      void add(const double time, const std::vector<double>& effort) {
+          if (started) {
+              addInterval(time - lastTime, effort);
+          }
+          started = true;
+          lastTime = time;
+          lastEffort = effort;
+      }
+
+      void getValues(MetricValues& values) const {
+          values.push_back(std::make_pair("total_force", totalForce.get()));
+      }
+
+    private:
+      void addInterval(const double deltaSecs, const std::vector<double>& effort) {
+          const unsigned int joints = std::min(effort.size(), lastEffort.size());
+          for (unsigned int i = 0; i < joints; ++i) {
+              const double current = effort[i];
+              const double last = lastEffort[i];
+              if (current == 0 && last == 0) {
+                  continue;
+              }
+
+              // When the effort changes sign, integrate each side of the zero crossing separately.
+              if ((current < 0) != (last < 0) && current != 0 && last != 0) {
+                  const double ratio = fabs(current) / fabs(last);
+                  const double l1 = ratio * deltaSecs / (1 + ratio);
+                  const double l2 = deltaSecs - l1;
+                  totalForce.add(square(0.5 * current * l1) + square(0.5 * last * l2));
+              }
+              else {
+                  // Apply trapezoidal rule
+                  totalForce.add(square(deltaSecs * (current + last) / 2.0));
+              }
+          }
+      }
+
+      static double square(const double a) {
+          return a * a;
+      }
+
+      bool started;
+      double lastTime;
+      std::vector<double> lastEffort;
+      CompensatedSum totalForce;
+  };
+
+  /**
+   * How long the dog position was known, how far the estimate was from the dog and
+   * how late the estimates arrived.
+   */
+  class DogTrackingMetric {
+    public:
+      DogTrackingMetric() : startTime(0), lastTime(0), lastKnownTime(0), knownTime(0), unknownTime(0) {
+      }
+
+      void start(const double time) {
+          startTime = lastTime = lastKnownTime = time;
+      }
+
+      void addUnknown(const double stamp) {
+          unknownTime += stamp - lastTime;
+          unknownDuration.add(stamp - lastKnownTime);
+          lastTime = stamp;
+      }
+
+      /**
+       * @param deviation Distance of the estimate from the dog in the ground plane.
+       * @param received Time the estimate was received.
+       */
+      void addKnown(const double stamp, const double deviation, const double received) {
+          const double timePassed = stamp - lastTime;
+          knownTime += timePassed;
+          positionDeviation.add(deviation * timePassed);
+          latency.add(received - stamp);
+          lastTime = lastKnownTime = stamp;
+      }
+
+      void getValues(const double stopTime, MetricValues& values) const {
+          const double totalTime = stopTime - startTime;
+          values.push_back(std::make_pair("known_time", knownTime));
+          values.push_back(std::make_pair("unknown_time", unknownTime));
+          values.push_back(std::make_pair("total_time", totalTime));
+          values.push_back(std::make_pair("percent_known", totalTime > 0 ? knownTime / totalTime * 100 : 0.0));
+          values.push_back(std::make_pair("percent_unknown", totalTime > 0 ? unknownTime / totalTime * 100 : 0.0));
+          values.push_back(std::make_pair("position_deviation_mean", positionDeviation.getMean()));
+          values.push_back(std::make_pair("position_deviation_variance", positionDeviation.getVariance()));
+          values.push_back(std::make_pair("latency_mean", latency.getMean()));
+          values.push_back(std::make_pair("latency_variance", latency.getVariance()));
+          values.push_back(std::make_pair("unknown_duration_mean", unknownDuration.getMean()));
+          values.push_back(std::make_pair("unknown_duration_variance", unknownDuration.getVariance()));
+      }
+
+    private:
+      double startTime;
+      double lastTime;
+      double lastKnownTime;
+      double knownTime;
+      double unknownTime;
+      RunningStatistics positionDeviation;
+      RunningStatistics latency;
+      RunningStatistics unknownDuration;
+  };
+
+  /**
+   * Fraction of the path in view integrated over the walk. Each ratio covers the
+   * time since the previous view.
+   */
+  class PathVisibilityMetric {
+    public:
+      PathVisibilityMetric() : startTime(0), lastTime(0) {
+      }
+
+      void start(const double time) {
+          startTime = lastTime = time;
+      }
+
+      void add(const double stamp, const double visibilityRatio) {
+          totalScore.add((stamp - lastTime) * visibilityRatio);
+          lastTime = stamp;
+      }
+
+      void getValues(const double stopTime, MetricValues& values) const {
+          values.push_back(std::make_pair("visibility_score", totalScore.get()));
+          values.push_back(std::make_pair("visibility_time", stopTime - startTime));
+      }
+
+    private:
+      double startTime;
+      double lastTime;
+      CompensatedSum totalScore;
+  };
+}
@@ -0,0 +1,484 @@
+#include <ros/ros.h>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <string>
+#include <boost/lexical_cast.hpp>
+#include <boost/math/constants/constants.hpp>
+#include <dogsim/utils.h>
+#include "path_provider_factory.h"
+#include "gaussian_perturbation.h"
+#include "dog_control.h"
+#include "leash_spring.h"
+#include "robot_path.h"
+#include "arguments.h"
+#include "walk_metrics.h"
+
+/**
+ * Runs a walk without Gazebo so controller and perturbation parameters can be
+ * screened quickly. The dog is a point mass on the ground driven by the same PD
+ * controller, gaussian perturbations and avoidance force as the dog model plugin,
+ * pulled by the sigmoid leash spring from the leash model plugin. The robot base
+ * is a kinematic model driven by the move_robot_action heuristics with the hand
+ * held beside it. Prints the path, leash_force and robot_path metrics of the
+ * metrics node, computed by the same metric classes from the samples the metrics
+ * node would receive: a dog and robot pose every physics step and a leash sample
+ * every leash update.
+ *
+ * Parameters are passed as name:=value, e.g.
+ * walk_simulator path_type:=lissajous dog_kp:=0.01 gauss_seed:=7
+ */
+namespace {
+using namespace std;
+
+//! Physics step. Matches the default Gazebo step and the dog update rate.
+const double STEP = UPDATE_RATE;
+
+//! Dog body from dog.model. Resting height is half the box height.
+const double DOG_MASS = 5.0;
+const double DOG_FRICTION = 0.09;
+const double DOG_REST_HEIGHT = 0.05;
+const double GRAVITY = 9.81;
+
+//! Height of the hand beside the robot base.
+const double HAND_HEIGHT_DEFAULT = 0.8;
+
+//! Spacing of the planned robot poses the robot_path metric interpolates, as in the metrics node.
+const double ROBOT_SCORER_INCREMENT = 0.1;
+
+//! Increment of the robot path followed by move_robot_action.
+const double ROBOT_PATH_INCREMENT = 0.25;
+
+//! Heuristics of move_robot_action.
+const unsigned int ROBOT_HZ = 50;
+const double DISTANCE_THRESHOLD = 0.1;
+const double Q_DISTANCE_THRESHOLD = 0.005;
+const double MAX_LINEAR_V = 0.5;
+const double STRAIGHT_AHEAD_FACTOR = 6.0;
+const double MAX_ANGULAR_V = 0.5;
+const double STATIONARY_FACTOR = 4.0;
+const double MAX_REVERSE_DISTANCE = 0.25;
+
+static const double PI = boost::math::constants::pi<double>();
+
+/**
+ * Wrap an angle to [-pi, pi].
+ */
+static double normalizeAngle(const double angle) {
+    return atan2(sin(angle), cos(angle));
+}
+
+/**
+ * Equivalent of calcQDistance in move_robot_action for two yaws.
+ */
+static double calcQDistance(const double yaw1, const double yaw2) {
+    return utils::square(sin((yaw1 - yaw2) / 2.0));
+}
+
+/**
+ * Kinematic robot base following the twist commands of move_robot_action.
+ */
+class RobotBase {
+  public:
+    RobotBase() : x(0), y(0), yaw(0), linear(0), angular(0) {
+    }
+
+    void reset(const geometry_msgs::PoseStamped& pose) {
+        x = pose.pose.position.x;
+        y = pose.pose.position.y;
+        yaw = tf::getYaw(pose.pose.orientation);
+        linear = angular = 0;
+    }
+
+    /**
+     * Choose the command that one cycle of move_robot_action would publish for the goal.
+     */
+    void command(const geometry_msgs::PoseStamped& absoluteGoal) {
+        // Goal in the base frame.
+        const double dx = absoluteGoal.pose.position.x - x;
+        const double dy = absoluteGoal.pose.position.y - y;
+        const double goalX = cos(yaw) * dx + sin(yaw) * dy;
+        const double goalY = -sin(yaw) * dx + cos(yaw) * dy;
+        const double goalYaw = normalizeAngle(tf::getYaw(absoluteGoal.pose.orientation) - yaw);
+
+        const double currentDistance = sqrt(utils::square(goalX) + utils::square(goalY));
+        if (currentDistance <= DISTANCE_THRESHOLD && calcQDistance(goalYaw, 0) <= Q_DISTANCE_THRESHOLD) {
+            linear = angular = 0;
+            return;
+        }
+
+        // The goal is replanned every cycle, so the distance to go is the total distance.
+        double ratio = 1;
+        if (currentDistance > DISTANCE_THRESHOLD) {
+            ratio = min(MAX_LINEAR_V / ROBOT_HZ / currentDistance, 1.0);
+        }
+
+        // Interpolate between the direction to the goal and the goal orientation.
+        const double yawToTarget = atan2(goalY, goalX);
+        double turn = normalizeAngle(yawToTarget + ratio * normalizeAngle(goalYaw - yawToTarget));
+
+        linear = currentDistance > DISTANCE_THRESHOLD ? MAX_LINEAR_V : 0;
+
+        // Determine if we should go backwards.
+        if (goalX < 0 && currentDistance > DISTANCE_THRESHOLD && fabs(turn) > 3 * PI / 4) {
+            if (currentDistance < MAX_REVERSE_DISTANCE) {
+                turn += turn > PI / 2.0 ? -PI : PI;
+                linear *= -1;
+            } else {
+                linear = 0;
+            }
+        } else if (calcQDistance(turn, 0) < Q_DISTANCE_THRESHOLD) {
+            // Turning slows the robot down, so avoid turning when possible.
+            turn = 0;
+        }
+
+        if (fabs(turn) > numeric_limits<double>::epsilon()) {
+            angular = copysign(MAX_ANGULAR_V, turn);
+            if (fabs(linear) < numeric_limits<double>::epsilon()) {
+                // If the robot is not moving forward use a faster turn.
+                angular *= STATIONARY_FACTOR;
+            }
+        } else {
+            linear *= STRAIGHT_AHEAD_FACTOR;
+            angular = 0;
+        }
+    }
+
+    void step(const double dt) {
+        x += linear * cos(yaw) * dt;
+        y += linear * sin(yaw) * dt;
+        yaw = normalizeAngle(yaw + angular * dt);
+    }
+
+    /**
+     * Position of the hand holding the leash, to the right of the base.
+     */
+    void getHandPosition(const double handHeight, double& handX, double& handY, double& handZ) const {
+        handX = x + SHIFT_DISTANCE * sin(yaw);
+        handY = y - SHIFT_DISTANCE * cos(yaw);
+        handZ = handHeight;
+    }
+
+    double x;
+    double y;
+    double yaw;
+
+  private:
+    double linear;
+    double angular;
+};
+
+class WalkSimulator {
+  public:
+    WalkSimulator() :
+        KP(KP_DEFAULT), KD(KD_DEFAULT), withRobot(true), dogHeight(DOG_HEIGHT_DEFAULT),
+        leashLength(LEASH_LENGTH_DEFAULT), handHeight(HAND_HEIGHT_DEFAULT), addGaussians(true) {
+    }
+
+    /**
+     * Read the arguments and set up the path and perturbations.
+     * @return False if an argument is invalid.
+     */
+    bool init(Arguments& args) {
+        try {
+            const string pathType = getArgument<string>(args, "path_type", "lissajous");
+            pathProvider.reset(createPathProvider(pathType));
+            if (!pathProvider.get()) {
+                ROS_ERROR("Unknown path type %s", pathType.c_str());
+                return false;
+            }
+            pathProvider->init();
+            maximumTime = pathProvider->getMaximumTime().toSec();
+            const double duration = getArgument<double>(args, "duration", 0.0);
+            if (duration > 0) {
+                maximumTime = min(maximumTime, duration);
+            }
+
+            KP = getArgument<double>(args, "dog_kp", KP_DEFAULT);
+            KD = getArgument<double>(args, "dog_kd", KD_DEFAULT);
+            withRobot = getArgument<bool>(args, "robot", true);
+            dogHeight = getArgument<double>(args, "dog_height", DOG_HEIGHT_DEFAULT);
+            leashLength = getArgument<double>(args, "leash_length", LEASH_LENGTH_DEFAULT);
+            handHeight = getArgument<double>(args, "hand_height", HAND_HEIGHT_DEFAULT);
+            addGaussians = getArgument<bool>(args, "add_gaussians_to_path", true);
+
+            GaussianParameters params;
+            params.pNewGauss = getArgument<double>(args, "p_new_gauss", P_NEW_GAUSS_DEFAULT);
+            params.gaussHeight = getArgument<double>(args, "gauss_height", 1.0);
+            params.gaussMinWidth = getArgument<double>(args, "gauss_min_width", 0.5);
+            params.gaussMaxWidth = getArgument<double>(args, "gauss_max_width", 8.0);
+            boost::mt19937 rng(getArgument<unsigned int>(args, "gauss_seed", GAUSS_SEED_DEFAULT));
+            if (addGaussians) {
+                perturbation.generate(rng, pathProvider->getMaximumTime().toSec(), params);
+            }
+        } catch (const boost::bad_lexical_cast& e) {
+            ROS_ERROR("Invalid argument: %s", e.what());
+            return false;
+        }
+
+        return checkArgumentsUsed(args);
+    }
+
+    /**
+     * Walk the whole path and add the metrics to the values.
+     */
+    void run(MetricValues& values) {
+        const geometry_msgs::Point start = pathProvider->positionAtTime(ros::Duration(0));
+        dogX = previousBaseX = start.x;
+        dogY = previousBaseY = start.y;
+        dogVelocityX = dogVelocityY = 0;
+        previousErrorX = previousErrorY = 0;
+        forceX = forceY = appliedForceX = appliedForceY = 0;
+        leashForceX = leashForceY = leashForceZ = 0;
+        robot.reset(plannedRobotPoseAt(0));
+
+        PathDeviationMetric pathMetric(dogHeight);
+        LeashForceMetric leashMetric(leashLength);
+        RobotPathDeviationMetric robotMetric;
+        UniformPath robotPath;
+        if (withRobot) {
+            samplePlannedRobotPath(robotPath);
+        }
+
+        const unsigned int stepCount = static_cast<unsigned int>(maximumTime / STEP);
+        const unsigned int leashSteps = static_cast<unsigned int>(LEASH_UPDATE_RATE / STEP + 0.5);
+        const unsigned int robotSteps = static_cast<unsigned int>(1.0 / ROBOT_HZ / STEP + 0.5);
+        for (unsigned int i = 1; i <= stepCount; ++i) {
+            const double t = i * STEP;
+
+            updateDogForce(t);
+            if (withRobot && i % robotSteps == 0) {
+                // First goal in the future, as in move_robot_action.
+                const unsigned int goal = static_cast<unsigned int>(t / ROBOT_PATH_INCREMENT) + 1;
+                robot.command(plannedRobotPoseAt(goal * ROBOT_PATH_INCREMENT));
+            }
+
+            if (withRobot && i % leashSteps == 0) {
+                const double distance = updateLeash();
+                const double force = sqrt(utils::square(leashForceX) + utils::square(leashForceY)
+                        + utils::square(leashForceZ));
+                leashMetric.add(t, force, distance);
+            }
+
+            stepDog();
+            robot.step(STEP);
+
+            const geometry_msgs::Point goal = pathProvider->positionAtTime(ros::Duration(t));
+            const double deviation = sqrt(utils::square(goal.x - dogX) + utils::square(goal.y - dogY)
+                    + utils::square(goal.z - DOG_REST_HEIGHT));
+            pathMetric.add(t, deviation, DOG_REST_HEIGHT);
+
+            if (withRobot) {
+                double goalX, goalY, goalZ;
+                robotPath.positionAt(t, goalX, goalY, goalZ);
+                robotMetric.add(t, sqrt(utils::square(goalX - robot.x) + utils::square(goalY - robot.y)
+                        + utils::square(goalZ)));
+            }
+        }
+
+        pathMetric.getValues(values);
+        if (withRobot) {
+            leashMetric.getValues(values);
+            robotMetric.getValues(values);
+        }
+    }
+
+    double getMaximumTime() const {
+        return maximumTime;
+    }
+
+    bool hasRobot() const {
+        return withRobot;
+    }
+
+  private:
+    /**
+     * Planned robot poses at the spacing the metrics node fetches them with.
+     */
+    void samplePlannedRobotPath(UniformPath& robotPath) const {
+        robotPath.reset(0.0, ROBOT_SCORER_INCREMENT);
+        const unsigned int count = static_cast<unsigned int>(maximumTime / ROBOT_SCORER_INCREMENT) + 1;
+        for (unsigned int i = 0; i <= count; ++i) {
+            const geometry_msgs::PoseStamped pose = plannedRobotPoseAt(i * ROBOT_SCORER_INCREMENT);
+            robotPath.add(pose.pose.position.x, pose.pose.position.y, pose.pose.position.z);
+        }
+    }
+
+    geometry_msgs::PoseStamped plannedRobotPoseAt(const double t) const {
+        const ros::Duration time(min(t, pathProvider->getMaximumTime().toSec()));
+        const geometry_msgs::Point dog = pathProvider->positionAtTime(time);
+        return getPlannedRobotPose(dog.x, dog.y, pathProvider->headingAtTime(time));
+    }
+
+    /**
+     * One update of the dog model plugin controller.
+     */
+    void updateDogForce(const double t) {
+        const geometry_msgs::Point base = pathProvider->positionAtTime(ros::Duration(t));
+        double goalX = base.x;
+        double goalY = base.y;
+        if (addGaussians) {
+            // The plugin perturbs with the whole seconds elapsed.
+            perturbation.perturb(floor(t), previousBaseX, previousBaseY, goalX, goalY);
+        }
+        previousBaseX = base.x;
+        previousBaseY = base.y;
+
+        const double errorX = goalX - dogX;
+        const double errorY = goalY - dogY;
+        forceX += KP * errorX + KD * (errorX - previousErrorX) / STEP;
+        forceY += KP * errorY + KD * (errorY - previousErrorY) / STEP;
+        forceX = copysign(min(fabs(forceX), MAXIMUM_FORCE), forceX);
+        forceY = copysign(min(fabs(forceY), MAXIMUM_FORCE), forceY);
+        previousErrorX = errorX;
+        previousErrorY = errorY;
+
+        // Push the dog away from the base of the robot.
+        double avoidanceForceX = 0;
+        double avoidanceForceY = 0;
+        if (withRobot) {
+            const double dx = dogX - robot.x;
+            const double dy = dogY - robot.y;
+            const double distance = sqrt(utils::square(dx) + utils::square(dy));
+            if (distance - BASE_RADIUS < MIN_DISTANCE_FROM_ROBOT && distance > 0) {
+                const double avoidanceForce = AVOIDANCE_FORCE_MULT * MAXIMUM_FORCE * 1.0
+                        / utils::square(MIN_DISTANCE_FROM_ROBOT)
+                        * utils::square(MIN_DISTANCE_FROM_ROBOT - max(distance - BASE_RADIUS, 0.0));
+                avoidanceForceX = avoidanceForce * dx / distance;
+                avoidanceForceY = avoidanceForce * dy / distance;
+            }
+        }
+
+        const double maximumApplied = AVOIDANCE_FORCE_MULT * MAXIMUM_FORCE;
+        appliedForceX = forceX + avoidanceForceX;
+        appliedForceY = forceY + avoidanceForceY;
+        appliedForceX = copysign(min(fabs(appliedForceX), maximumApplied), appliedForceX);
+        appliedForceY = copysign(min(fabs(appliedForceY), maximumApplied), appliedForceY);
+    }
+
+    /**
+     * One update of the leash model plugin spring.
+     * @return Distance between the hand and the dog.
+     */
+    double updateLeash() {
+        double handX, handY, handZ;
+        robot.getHandPosition(handHeight, handX, handY, handZ);
+        const double dx = handX - dogX;
+        const double dy = handY - dogY;
+        const double dz = handZ - DOG_REST_HEIGHT;
+        const double distance = sqrt(utils::square(dx) + utils::square(dy) + utils::square(dz));
+        const double force = distance > 0 ? SPRING_FORCE * calcSpringRatio(distance, leashLength) / distance : 0;
+        leashForceX = force * dx;
+        leashForceY = force * dy;
+        leashForceZ = force * dz;
+        return distance;
+    }
+
+    /**
+     * Integrate the dog on the ground with coulomb friction.
+     */
+    void stepDog() {
+        const double netX = appliedForceX + leashForceX;
+        const double netY = appliedForceY + leashForceY;
+
+        // The leash lifts part of the weight off the ground.
+        const double friction = DOG_FRICTION * max(DOG_MASS * GRAVITY - leashForceZ, 0.0);
+        const double speed = sqrt(utils::square(dogVelocityX) + utils::square(dogVelocityY));
+        if (speed <= 0) {
+            const double net = sqrt(utils::square(netX) + utils::square(netY));
+            if (net <= friction) {
+                return;
+            }
+            dogVelocityX += (netX - friction * netX / net) / DOG_MASS * STEP;
+            dogVelocityY += (netY - friction * netY / net) / DOG_MASS * STEP;
+        } else {
+            const double velocityX = dogVelocityX + (netX - friction * dogVelocityX / speed) / DOG_MASS * STEP;
+            const double velocityY = dogVelocityY + (netY - friction * dogVelocityY / speed) / DOG_MASS * STEP;
+
+            // Friction stops the dog rather than reversing it.
+            if (velocityX * dogVelocityX + velocityY * dogVelocityY < 0) {
+                dogVelocityX = dogVelocityY = 0;
+            } else {
+                dogVelocityX = velocityX;
+                dogVelocityY = velocityY;
+            }
+        }
+        dogX += dogVelocityX * STEP;
+        dogY += dogVelocityY * STEP;
+    }
+
+    auto_ptr<PathProvider> pathProvider;
+    GaussianPerturbation perturbation;
+    double maximumTime;
+
+    // KP term
+    double KP;
+
+    // KD term
+    double KD;
+
+    //! False to walk the dog alone, without the robot or the leash.
+    bool withRobot;
+    double dogHeight;
+    double leashLength;
+    double handHeight;
+    bool addGaussians;
+
+    double dogX;
+    double dogY;
+    double dogVelocityX;
+    double dogVelocityY;
+
+    double previousBaseX;
+    double previousBaseY;
+    double previousErrorX;
+    double previousErrorY;
+    double forceX;
+    double forceY;
+    double appliedForceX;
+    double appliedForceY;
+
+    //! Leash force on the dog, updated at the leash rate and applied every step.
+    double leashForceX;
+    double leashForceY;
+    double leashForceZ;
+
+    RobotBase robot;
+};
+}
+
+int main(int argc, char** argv) {
+    ros::Time::init();
+
+    Arguments args;
+    WalkSimulator simulator;
+    if (!parseArguments(argc, argv, args) || !simulator.init(args)) {
+        return 1;
+    }
+
+    MetricValues values;
+    const ros::WallTime startTime = ros::WallTime::now();
+    simulator.run(values);
+    const double wallTime = (ros::WallTime::now() - startTime).toSec();
+
+    ROS_INFO("Path measurement ended. Total position deviation squared(m): %f", getValue(values, "path_deviation"));
+    ROS_INFO("Mean height deviation: %f", getValue(values, "height_deviation"));
+    if (simulator.hasRobot()) {
+        ROS_INFO("Total leash force(N): %f", getValue(values, "leash_force"));
+        ROS_INFO("Mean Leash Stretch: %f, Leash Stretch Variance: %f, Maximum Leash Stretch: %f",
+                getValue(values, "stretch_mean"), getValue(values, "stretch_variance"),
+                getValue(values, "stretch_max"));
+        ROS_INFO("Robot Path measurement ended. Total position deviation squared(m): %f",
+                getValue(values, "robot_deviation"));
+    }
+    ROS_INFO("Simulated %f s in %f s of wall time", simulator.getMaximumTime(), wallTime);
+
+    // One line for sweep scripts to collect.
+    values.push_back(make_pair("sim_time", simulator.getMaximumTime()));
+    values.push_back(make_pair("wall_time", wallTime));
+    for (unsigned int i = 0; i < values.size(); ++i) {
+        printf("%s%s %f", i > 0 ? " " : "", values[i].first.c_str(), values[i].second);
+    }
+    printf("\n");
+    return 0;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <string>
+#include <algorithm>
+#include <ros/ros.h>
+#include <gazebo_msgs/ModelStates.h>
+#include <dogsim/GroundTruth.h>
+
+namespace {
+
+  // Streams of a walk that the metrics node scores and the recorder records.
+
+  //! True poses stamped with the sim time of the world update. See GroundTruth.msg.
+  const std::string GROUND_TRUTH_TOPIC = "/dogsim/ground_truth";
+
+  //! Ground truth is published every physics step, so keep enough to ride out a slow callback.
+  const unsigned int GROUND_TRUTH_QUEUE_SIZE = 100;
+
+  //! Published by the world whatever models are in it. Read when there is no ground truth.
+  const std::string MODEL_STATES_TOPIC = "/gazebo/model_states";
+
+  //! Sim time without ground truth after which the model states are used instead.
+  const double GROUND_TRUTH_TIMEOUT = 1.0;
+
+  const std::string LEASH_TOPIC = "leash_model/info_array";
+  const std::string JOINT_STATES_TOPIC = "joint_states";
+  const std::string DOG_POSITION_TOPIC = "/dog_position_detector/dog_position";
+  const std::string PATH_VIEW_TOPIC = "/path_visibility_detector/view";
+
+  //! Queue size of the streams other than the ground truth.
+  const unsigned int STREAM_QUEUE_SIZE = 10;
+
+  /**
+   * Find a model in the model states. The order only changes when models are added
+   * or removed, so the last index is checked first.
+   */
+  static bool findModel(const gazebo_msgs::ModelStates& states, const std::string& name, unsigned int& index) {
+      if (index < states.name.size() && states.name[index] == name) {
+          return true;
+      }
+      for (unsigned int i = 0; i < states.name.size(); ++i) {
+          if (states.name[i] == name) {
+              index = i;
+              return true;
+          }
+      }
+      return false;
+  }
+
+  /**
+   * Builds ground truth from the model states while no ground truth arrives. Only the
+   * dog model plugin publishes ground truth, so the solo robot scenarios, the dog pack
+   * and the end of a walk after the dog plugin stops have none.
+   *
+   * The model states are not stamped. They are published after the clock in the same
+   * world update, so each is stamped with the latest clock, and states that arrive
+   * before the next clock are dropped. That stamp runs ahead of the states when the
+   * callbacks fall behind, so real ground truth is preferred.
+   */
+  class ModelStatesGroundTruth {
+    public:
+      explicit ModelStatesGroundTruth(const std::string& _dogName) :
+          dogName(_dogName), dogIndex(0), robotIndex(0) {
+      }
+
+      //! Called with each ground truth message received.
+      void onGroundTruth(const dogsim::GroundTruth& truth) {
+          lastTruthTime = std::max(lastTruthTime, truth.header.stamp);
+      }
+
+      /**
+       * Build ground truth from the states at the current sim time.
+       * @return False if ground truth arrived recently or the clock has not moved.
+       */
+      bool convert(const gazebo_msgs::ModelStates& states, dogsim::GroundTruth& truth) {
+          const ros::Time now = ros::Time::now();
+          if (!lastTruthTime.isZero() && (now - lastTruthTime).toSec() < GROUND_TRUTH_TIMEOUT) {
+              return false;
+          }
+          if (!lastStatesTime.isZero() && now <= lastStatesTime) {
+              return false;
+          }
+          lastStatesTime = now;
+
+          truth.header.stamp = now;
+          truth.header.frame_id = "/map";
+          truth.hasDog = findModel(states, dogName, dogIndex);
+          truth.dogName = truth.hasDog ? dogName : "";
+          if (truth.hasDog) {
+              truth.dog = states.pose[dogIndex];
+          }
+          truth.hasRobot = findModel(states, "pr2", robotIndex);
+          if (truth.hasRobot) {
+              truth.robot = states.pose[robotIndex];
+          }
+          return true;
+      }
+
+    private:
+      const std::string dogName;
+      unsigned int dogIndex;
+      unsigned int robotIndex;
+
+      //! Latest stamp of the ground truth received.
+      ros::Time lastTruthTime;
+
+      //! Sim time of the last model states converted.
+      ros::Time lastStatesTime;
+  };
+}